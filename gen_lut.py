@@ -1,19 +1,36 @@
 #!/usr/bin/env python3
 # vim: noexpandtab ts=4 sw=4 sts=4
-
+#
+# Generates the constant FFT tables (lut.h and lut.c) for the FFT_EXPONENT
+# configured in config.h, and the gamma table of the LED output for LED_GAMMA
+# and LED_GAMMA_BITS. Called by the Makefile:
+#
+#   gen_lut.py <config.h> <output directory>
+
+import os
+import re
 import sys
 from math import *
 
-preamble = """#ifndef LUT_H
+header_preamble = """#ifndef LUT_H
 #define LUT_H
 // This file was auto-generated using gen_lut.py
 
+#include <stdint.h>
+
 #include "config.h"
 
-"""
+#if FFT_EXPONENT != {exponent}
+#error "lut.h was generated for a different FFT_EXPONENT"
+#endif
 
-postamble = """
+#if LED_GAMMA_BITS != {gamma_bits}
+#error "lut.h was generated for a different LED_GAMMA_BITS"
+#endif
 
+"""
+
+header_postamble = """
 static inline fft_value_type lookup_sin(int layer, int element) {
 	int idx = element * (1 << (FFT_EXPONENT - layer - 1)) + LUT_SIZE/2;
 	int factor = 1;
@@ -32,26 +49,186 @@ static inline fft_value_type lookup_cos(int layer, int element) {
 #endif // LUT_H
 """
 
-if len(sys.argv) < 2:
-	print("Argument required: FFT_EXPONENT")
+source_preamble = """// This file was auto-generated using gen_lut.py
+
+#include <stdint.h>
+
+#include "config.h"
+
+#include "lut.h"
+
+"""
+
+
+def read_define(config_file, name, value_pattern):
+	with open(config_file) as f:
+		for line in f:
+			m = re.match(r"\s*#define\s+" + name + r"\s+" + value_pattern + r"(\s|$)", line)
+			if m:
+				return m.group(1)
+
+	print(name + " not found in " + config_file)
 	exit(1)
 
-fft_exponent = int(sys.argv[1])
 
-with open("src/fft/lut.h", "w") as ofile:
-	ofile.write(preamble)
+def read_int(config_file, name):
+	return int(read_define(config_file, name, r"(\d+)"))
 
-	# generate the cos() lookup table
-	num_elements = (1 << (fft_exponent-1))
-	ofile.write("#define LUT_SIZE {:d}\n\n".format(num_elements))
 
-	ofile.write("static fft_value_type cos_lut[LUT_SIZE] = {")
+def read_float(config_file, name):
+	# optional f suffix of float constants
+	return float(read_define(config_file, name, r"([0-9.]+(?:[eE][-+]?\d+)?)[fF]?"))
 
-	ofile.write("1.0")
 
-	for element in range(1, num_elements):
-		ofile.write(", %.10f" % cos(-pi * element / num_elements));
+def float_literal(value):
+	# shortest representation that survives the conversion to float; rounding
+	# noise like cos(pi/2) = 6e-17 is written as an exact zero
+	if abs(value) < 1e-12:
+		value = 0.0
+	s = "%.9g" % value
+	if "." not in s and "e" not in s:
+		s += ".0"
+	return s + "f"
 
+
+def q15(value):
+	# same rounding as a conversion of the float value in C
+	v = value * 32767.0
+	return int(v + 0.5) if v >= 0 else int(v - 0.5)
+
+
+def write_table(ofile, decl, values, per_line=8):
+	ofile.write(decl + " = {\n")
+	for i in range(0, len(values), per_line):
+		ofile.write("\t" + ", ".join(values[i:i+per_line]) + ",\n")
 	ofile.write("};\n\n")
 
-	ofile.write(postamble)
+
+def led_gamma_table(gamma, bits):
+	# gamma correction of the LED output: 8 bit PWM value = 255 * x^gamma for
+	# the linear brightness x. The table is indexed with the top bits of a 16
+	# bit linear value and has 8 fractional bits for the dithering.
+	size = 1 << bits
+	return [int(round(255 * 256 * (i / (size - 1)) ** gamma)) for i in range(size)]
+
+
+def bitrev(i, bits):
+	r = 0
+	for b in range(bits):
+		r |= ((i >> b) & 1) << (bits - b - 1)
+	return r
+
+
+def radix4_twiddles(exponent):
+	# twiddles for the radix-4 stages of the complex FFT inside
+	# fft_transform_real(), see fft.c
+	n = 1 << exponent
+	r4_exponent = exponent - 1
+	values = []
+
+	s = 1 << (r4_exponent % 2)
+	while s < (1 << r4_exponent):
+		for j in range(s):
+			for r in range(1, 4):
+				m = r * j * (n // (4 * s))
+				values.append(cos(2 * pi * m / n))
+				values.append(-sin(2 * pi * m / n))
+		s *= 4
+
+	return values
+
+
+if len(sys.argv) < 3:
+	print("Arguments required: <config.h> <output directory>")
+	exit(1)
+
+fft_exponent = read_int(sys.argv[1], "FFT_EXPONENT")
+led_gamma = read_float(sys.argv[1], "LED_GAMMA")
+led_gamma_bits = read_int(sys.argv[1], "LED_GAMMA_BITS")
+outdir = sys.argv[2]
+
+if led_gamma_bits < 1 or led_gamma_bits > 16:
+	print("LED_GAMMA_BITS must be between 1 and 16")
+	exit(1)
+
+block_len = 1 << fft_exponent
+lut_size = block_len // 2
+
+index_type = "uint8_t" if block_len <= 256 else "uint16_t"
+
+cos_values = [cos(2 * pi * m / block_len) for m in range(lut_size)]
+window_values = [0.5 * (1 - cos(2 * pi * i / block_len)) for i in range(block_len)]
+r4_values = radix4_twiddles(fft_exponent)
+
+os.makedirs(outdir, exist_ok=True)
+
+with open(os.path.join(outdir, "lut.h"), "w") as ofile:
+	ofile.write(header_preamble.format(exponent=fft_exponent, gamma_bits=led_gamma_bits))
+
+	ofile.write("#define LUT_SIZE {:d}\n\n".format(lut_size))
+
+	ofile.write("// narrowest type for indices into a block\n")
+	ofile.write("typedef {:s} fft_index_type;\n\n".format(index_type))
+
+	ofile.write("// cos(2*pi*m/FFT_BLOCK_LEN), m < LUT_SIZE\n")
+	ofile.write("extern const fft_value_type cos_lut[LUT_SIZE];\n\n")
+
+	ofile.write("// Hann window\n")
+	ofile.write("extern const fft_value_type window_buffer[FFT_BLOCK_LEN];\n\n")
+
+	ofile.write("// bit-reversed indices of a FFT_BLOCK_LEN point transform\n")
+	ofile.write("extern const fft_index_type lookup_table[FFT_BLOCK_LEN];\n\n")
+
+	ofile.write("// W^m = exp(-2*pi*i*m/FFT_BLOCK_LEN) as re/im pairs, m < FFT_BLOCK_LEN\n")
+	ofile.write("extern const fft_value_type twiddle_lut[2 * FFT_BLOCK_LEN];\n\n")
+
+	ofile.write("// twiddles of the radix-4 stages, see fft.c\n")
+	ofile.write("#define RADIX4_TWIDDLE_LEN {:d}\n".format(len(r4_values)))
+	ofile.write("extern const fft_value_type radix4_twiddles[RADIX4_TWIDDLE_LEN];\n\n")
+
+	ofile.write("// Q15 versions of window_buffer and of W^m (packed), m < FFT_BLOCK_LEN/2\n")
+	ofile.write("extern const int16_t q15_window[FFT_BLOCK_LEN];\n")
+	ofile.write("extern const uint32_t fft_q15_twiddles[FFT_BLOCK_LEN/2];\n\n")
+
+	ofile.write("// 255 * x^{:g} in 8.8 fixed point for x = i/(LED_GAMMA_SIZE-1), see ws2801.h\n".format(led_gamma))
+	ofile.write("#define LED_GAMMA_SIZE (1 << LED_GAMMA_BITS)\n")
+	ofile.write("extern const uint16_t led_gamma_lut[LED_GAMMA_SIZE];\n")
+
+	ofile.write(header_postamble)
+
+with open(os.path.join(outdir, "lut.c"), "w") as ofile:
+	ofile.write(source_preamble)
+
+	write_table(ofile, "const fft_value_type cos_lut[LUT_SIZE]",
+			[float_literal(v) for v in cos_values])
+
+	write_table(ofile, "const fft_value_type window_buffer[FFT_BLOCK_LEN]",
+			[float_literal(v) for v in window_values])
+
+	write_table(ofile, "const fft_index_type lookup_table[FFT_BLOCK_LEN]",
+			[str(bitrev(i, fft_exponent)) for i in range(block_len)], 16)
+
+	twiddles = []
+	for m in range(block_len):
+		twiddles.append(cos(2 * pi * m / block_len))
+		twiddles.append(-sin(2 * pi * m / block_len))
+
+	write_table(ofile, "const fft_value_type twiddle_lut[2 * FFT_BLOCK_LEN]",
+			[float_literal(v) for v in twiddles])
+
+	write_table(ofile, "const fft_value_type radix4_twiddles[RADIX4_TWIDDLE_LEN]",
+			[float_literal(v) for v in r4_values])
+
+	write_table(ofile, "const int16_t q15_window[FFT_BLOCK_LEN]",
+			[str(q15(v)) for v in window_values], 16)
+
+	q15_twiddles = []
+	for m in range(lut_size):
+		re_part = q15(cos(2 * pi * m / block_len)) & 0xFFFF
+		im_part = q15(-sin(2 * pi * m / block_len)) & 0xFFFF
+		q15_twiddles.append("0x%08X" % (re_part | (im_part << 16)))
+
+	write_table(ofile, "const uint32_t fft_q15_twiddles[FFT_BLOCK_LEN/2]", q15_twiddles)
+
+	write_table(ofile, "const uint16_t led_gamma_lut[LED_GAMMA_SIZE]",
+			[str(v) for v in led_gamma_table(led_gamma, led_gamma_bits)], 16)
@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "audio_file.h"
+#include "adc_convert.h"
+#include "pdm2pcm.h"
+
+#define PDM_OVERSAMPLING 64
+#define PDM_BLOCK_WORDS  (AUDIO_BLOCK_LEN * PDM_OVERSAMPLING / 32)
+
+// maximum number of channels of a WAV file
+#define WAV_MAX_CHANNELS 8
+
+static FILE *file = NULL;
+static enum audio_file_format file_format;
+static uint8_t running;
+
+// start of the sample data and bytes per frame (all channels)
+static long data_offset;
+static uint32_t frame_size;
+
+static struct audio_queue file_queue;
+static struct adc_convert_ctx file_adc;
+static struct pdm2pcm_ctx file_pdm;
+
+static uint32_t read_le(const uint8_t *p, int bytes)
+{
+	uint32_t v = 0;
+
+	for(int i = bytes - 1; i >= 0; i--) {
+		v = (v << 8) | p[i];
+	}
+
+	return v;
+}
+
+// find the sample data of a WAV file; returns 0 on success
+static int parse_wav(void)
+{
+	uint8_t hdr[16];
+	int have_fmt = 0;
+
+	if(fread(hdr, 1, 12, file) != 12
+			|| memcmp(hdr, "RIFF", 4) != 0 || memcmp(hdr + 8, "WAVE", 4) != 0) {
+		fprintf(stderr, "audio_file: not a WAV file\n");
+		return -1;
+	}
+
+	// chunk header: ID and size
+	while(fread(hdr, 1, 8, file) == 8) {
+		uint32_t size = read_le(hdr + 4, 4);
+
+		if(memcmp(hdr, "fmt ", 4) == 0 && size >= 16) {
+			if(fread(hdr, 1, 16, file) != 16) {
+				break;
+			}
+
+			uint32_t format = read_le(hdr, 2);
+			uint32_t channels = read_le(hdr + 2, 2);
+			uint32_t rate = read_le(hdr + 4, 4);
+			uint32_t bits = read_le(hdr + 14, 2);
+
+			if(format != 1 || bits != 16 || channels < 1 || channels > WAV_MAX_CHANNELS) {
+				fprintf(stderr, "audio_file: only 16 bit PCM WAV files are supported\n");
+				return -1;
+			}
+
+			if(rate != SAMPLE_RATE) {
+				fprintf(stderr, "audio_file: warning: sample rate is %u Hz, processing at %u Hz\n",
+						(unsigned)rate, (unsigned)SAMPLE_RATE);
+			}
+
+			frame_size = 2 * channels;
+			have_fmt = 1;
+			size -= 16;
+		} else if(memcmp(hdr, "data", 4) == 0 && have_fmt) {
+			data_offset = ftell(file);
+			return 0;
+		}
+
+		// chunks are padded to an even size
+		if(fseek(file, size + (size & 1), SEEK_CUR) != 0) {
+			break;
+		}
+	}
+
+	fprintf(stderr, "audio_file: no sample data in WAV file\n");
+	return -1;
+}
+
+int audio_file_open(const char *path, enum audio_file_format format)
+{
+	audio_file_close();
+
+	file = fopen(path, "rb");
+	if(!file) {
+		return -1;
+	}
+
+	file_format = format;
+	data_offset = 0;
+	frame_size = 2;
+
+	if(format == AUDIO_FILE_WAV && parse_wav() != 0) {
+		audio_file_close();
+		return -1;
+	}
+
+	return 0;
+}
+
+void audio_file_close(void)
+{
+	if(file) {
+		fclose(file);
+		file = NULL;
+	}
+}
+
+// read and convert the next block; returns 0 at the end of the file
+static int read_block(struct audio_block *block)
+{
+	if(file_format == AUDIO_FILE_PDM) {
+		uint32_t words[PDM_BLOCK_WORDS];
+
+		if(fread(words, sizeof(words[0]), PDM_BLOCK_WORDS, file) != PDM_BLOCK_WORDS) {
+			return 0;
+		}
+
+		pdm2pcm_decode_samples(&file_pdm, words, PDM_BLOCK_WORDS, block->samples);
+		audio_block_update_mean(block);
+	} else {
+		uint8_t bytes[2 * WAV_MAX_CHANNELS * AUDIO_BLOCK_LEN];
+		uint16_t adc[AUDIO_BLOCK_LEN];
+
+		if(fread(bytes, frame_size, AUDIO_BLOCK_LEN, file) != AUDIO_BLOCK_LEN) {
+			return 0;
+		}
+
+		// first channel to unsigned 12 bit, as sampled by the ADC
+		for(uint32_t i = 0; i < AUDIO_BLOCK_LEN; i++) {
+			int16_t v = (int16_t)read_le(bytes + i * frame_size, 2);
+
+			adc[i] = (uint16_t)(v + 32768) >> (16 - ADC_BITS);
+		}
+
+		adc_convert_block(&file_adc, adc, block);
+	}
+
+	return 1;
+}
+
+static void file_source_init(void)
+{
+	audio_queue_init(&file_queue);
+	adc_convert_init(&file_adc, ADC_DC_CORNER_FREQ);
+	pdm2pcm_init(&file_pdm, PDM_OVERSAMPLING);
+	running = 0;
+
+	if(file) {
+		fseek(file, data_offset, SEEK_SET);
+	}
+}
+
+static void file_source_start(void)
+{
+	running = 1;
+}
+
+static void file_source_stop(void)
+{
+	running = 0;
+}
+
+/*
+ * The file is read on demand: a new block is produced when the queue is
+ * empty, so the consumer never falls behind.
+ */
+static const struct audio_block* file_source_get_block(void)
+{
+	const struct audio_block *block = audio_queue_peek(&file_queue);
+
+	if(!block && running && file) {
+		struct audio_block *next = audio_queue_begin_write(&file_queue);
+
+		if(next && read_block(next)) {
+			audio_queue_commit(&file_queue);
+			block = audio_queue_peek(&file_queue);
+		}
+	}
+
+	return block;
+}
+
+static void file_source_release_block(void)
+{
+	audio_queue_release(&file_queue);
+}
+
+static uint32_t file_source_get_dropped(void)
+{
+	return audio_queue_get_dropped(&file_queue);
+}
+
+const struct audio_source audio_source_file = {
+	.name = "file",
+	.init = file_source_init,
+	.start = file_source_start,
+	.stop = file_source_stop,
+	.get_block = file_source_get_block,
+	.release_block = file_source_release_block,
+	.get_dropped = file_source_get_dropped,
+};
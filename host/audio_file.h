@@ -0,0 +1,29 @@
+#ifndef AUDIO_FILE_H
+#define AUDIO_FILE_H
+
+#include "audio_source.h"
+
+enum audio_file_format {
+	AUDIO_FILE_PCM16, // signed 16 bit little endian, mono
+	AUDIO_FILE_WAV,   // 16 bit PCM, only the first channel is used
+	AUDIO_FILE_PDM,   // 32 bit words as written by the I2S DMA, 64x oversampling
+};
+
+/*
+ * Host audio source reading a recording. The file has to be opened before
+ * init() is called on audio_source_file. A partial block at the end of the
+ * file is discarded.
+ *
+ * PCM samples take the path of the ADC source: they are reduced to 12 bit
+ * ADC values and converted by adc_convert_block(), including the DC removal.
+ * PDM data is decoded like in the MP45DT02 source.
+ *
+ * Returns 0 on success, -1 if the file cannot be opened or is not a supported
+ * WAV file.
+ */
+int audio_file_open(const char *path, enum audio_file_format format);
+void audio_file_close(void);
+
+extern const struct audio_source audio_source_file;
+
+#endif // AUDIO_FILE_H
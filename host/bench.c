@@ -0,0 +1,415 @@
+/*
+ * Micro-benchmark for the DSP modules on the development machine.
+ *
+ * Every stage is run repeatedly on fixed synthetic input. For each stage the
+ * time per call, the number of calls per second and the realtime factor (how
+ * much faster than SAMPLE_RATE the stage can process audio) are reported.
+ *
+ * Usage: bench [min. seconds per stage]
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "config.h"
+#include "fft/fft.h"
+#include "fft/fft_q15.h"
+#include "fft/sdft.h"
+#include "fft/filterbank.h"
+#include "pdm2pcm.h"
+#include "adc_convert.h"
+#include "fft/decimator.h"
+#include "trigon.h"
+
+#define PDM_BUFFER_WORDS 64
+#define PDM_OVERSAMPLING 64
+
+struct bench {
+	const char *name;
+	void (*run)(void);
+
+	// audio samples processed per call, 0 if not applicable
+	double samples_per_call;
+};
+
+// keeps the compiler from optimizing away unused results
+static volatile float sink;
+
+static fft_sample samples[FFT_BLOCK_LEN];
+static fft_sample windowed[FFT_BLOCK_LEN];
+static fft_value_type fft_re[FFT_BLOCK_LEN];
+static fft_value_type fft_im[FFT_BLOCK_LEN];
+static fft_value_type fft_abs[FFT_DATALEN];
+static fft_value_type fft_buf[FFT_BLOCK_LEN];
+
+static int16_t q15_samples[FFT_BLOCK_LEN];
+static int16_t q15_windowed[FFT_BLOCK_LEN];
+static uint32_t q15_bits;
+static uint32_t q15_cplx[FFT_DATALEN];
+static uint32_t q15_abs[FFT_DATALEN];
+static int q15_exponent;
+
+static struct filterbank fb_musiclight;
+static struct filterbank fb_mel;
+static fft_value_type fb_energy[FILTERBANK_MAX_OUTPUTS];
+
+static const struct filterbank_band musiclight_bands[] = {
+	{   0,   400, FILTERBANK_RECT, 0, 1.0f},
+	{ 400,  2450, FILTERBANK_RECT, 1, 1.0f},
+	{2550,  4000, FILTERBANK_RECT, 1, 1.0f},
+	{4000,  4935, FILTERBANK_RECT, 2, 1.0f},
+	{5065,  7420, FILTERBANK_RECT, 2, 1.0f},
+	{7580,  9900, FILTERBANK_RECT, 2, 1.0f},
+};
+
+static struct sdft_ctx sdft;
+static fft_value_type sdft_abs[SDFT_NUM_BINS];
+
+static uint32_t pdm_data[PDM_BUFFER_WORDS];
+static int32_t pcm_data[PDM_BUFFER_WORDS * 32 / PDM_OVERSAMPLING + 1];
+static fft_sample pcm_samples[PDM_BUFFER_WORDS * 32 / PDM_OVERSAMPLING + 1];
+static struct pdm2pcm_ctx pdm_ctx;
+
+static uint16_t adc_raw[AUDIO_BLOCK_LEN];
+static struct audio_block adc_block;
+static struct adc_convert_ctx adc_ctx;
+
+static struct decimator_ctx decimator;
+static fft_sample decimated[AUDIO_BLOCK_LEN / DECIMATOR_FACTOR + 1];
+
+/*** stages ***/
+
+static void bench_fft_copy_windowed(void)
+{
+	fft_copy_windowed(samples, windowed);
+}
+
+static void bench_fft_transform(void)
+{
+	fft_transform(windowed, fft_re, fft_im);
+}
+
+static void bench_fft_transform_real(void)
+{
+	fft_transform_real(windowed, fft_re, fft_im);
+}
+
+static void bench_fft_transform_real_inplace(void)
+{
+	// the transform overwrites its input, so it gets a fresh copy every time
+	memcpy(fft_buf, windowed, sizeof(fft_buf));
+	fft_transform_real_inplace(fft_buf);
+}
+
+static void bench_fft_complex_to_absolute(void)
+{
+	fft_complex_to_absolute(fft_re, fft_im, fft_abs);
+}
+
+static void bench_fft_complex_to_power(void)
+{
+	fft_complex_to_power(fft_re, fft_im, fft_abs);
+}
+
+static void bench_fft_complex_to_absolute_approx(void)
+{
+	fft_complex_to_absolute_approx(fft_re, fft_im, fft_abs);
+}
+
+static void bench_fft_packed_to_absolute(void)
+{
+	fft_packed_to_absolute(fft_buf, fft_abs);
+}
+
+static void bench_fft_get_energy_in_band(void)
+{
+	// the bands used by musiclight()
+	sink = fft_get_energy_in_band(fft_abs, 0, 400)
+		+ fft_get_energy_in_band(fft_abs, 400, 2450)
+		+ fft_get_energy_in_band(fft_abs, 2550, 4000)
+		+ fft_get_energy_in_band(fft_abs, 4000, 4935)
+		+ fft_get_energy_in_band(fft_abs, 5065, 7420)
+		+ fft_get_energy_in_band(fft_abs, 7580, 9900);
+}
+
+static void bench_filterbank_musiclight(void)
+{
+	filterbank_apply(&fb_musiclight, fft_abs, fb_energy);
+}
+
+static void bench_filterbank_mel(void)
+{
+	filterbank_apply(&fb_mel, fft_abs, fb_energy);
+}
+
+static void bench_float_pipeline(void)
+{
+	bench_fft_copy_windowed();
+	bench_fft_transform_real();
+	bench_fft_complex_to_absolute();
+	bench_filterbank_musiclight();
+}
+
+static void bench_float_pipeline_inplace(void)
+{
+	fft_copy_windowed(samples, fft_buf);
+	fft_transform_real_inplace(fft_buf);
+	bench_fft_packed_to_absolute();
+	bench_filterbank_musiclight();
+}
+
+static void bench_q15_copy_windowed(void)
+{
+	fft_q15_copy_windowed(q15_samples, q15_windowed);
+}
+
+static void bench_q15_transform_real(void)
+{
+	q15_exponent = fft_q15_transform_real(q15_windowed, q15_cplx);
+}
+
+static void bench_q15_load_windowed(void)
+{
+	q15_bits = fft_q15_load_windowed(q15_samples, q15_cplx);
+}
+
+static void bench_q15_complex_to_absolute(void)
+{
+	fft_q15_complex_to_absolute(q15_cplx, q15_exponent, q15_abs);
+}
+
+static void bench_q15_get_energy_in_band(void)
+{
+	sink = fft_q15_get_energy_in_band(q15_abs, 0, 400)
+		+ fft_q15_get_energy_in_band(q15_abs, 400, 2450)
+		+ fft_q15_get_energy_in_band(q15_abs, 2550, 4000)
+		+ fft_q15_get_energy_in_band(q15_abs, 4000, 4935)
+		+ fft_q15_get_energy_in_band(q15_abs, 5065, 7420)
+		+ fft_q15_get_energy_in_band(q15_abs, 7580, 9900);
+}
+
+static void bench_q15_pipeline(void)
+{
+	bench_q15_copy_windowed();
+	bench_q15_transform_real();
+	bench_q15_complex_to_absolute();
+	bench_q15_get_energy_in_band();
+}
+
+static void bench_q15_pipeline_fused(void)
+{
+	bench_q15_load_windowed();
+	q15_exponent = fft_q15_transform_loaded(q15_cplx, q15_bits);
+	bench_q15_complex_to_absolute();
+	bench_q15_get_energy_in_band();
+}
+
+static void bench_sdft_update(void)
+{
+	for(uint32_t i = 0; i < STFT_HOP_SIZE; i++) {
+		sdft_update(&sdft, samples[i]);
+	}
+}
+
+static void bench_sdft_get_absolute(void)
+{
+	sdft_get_absolute(&sdft, sdft_abs);
+}
+
+static void bench_sdft_get_energy_in_band(void)
+{
+	sink = sdft_get_energy_in_band(&sdft, 0, 400)
+		+ sdft_get_energy_in_band(&sdft, 400, 2450)
+		+ sdft_get_energy_in_band(&sdft, 2550, 4000)
+		+ sdft_get_energy_in_band(&sdft, 4000, 4935)
+		+ sdft_get_energy_in_band(&sdft, 5065, 7420)
+		+ sdft_get_energy_in_band(&sdft, 7580, 9900);
+}
+
+static void bench_pdm2pcm_decode(void)
+{
+	sink = pdm2pcm_decode(&pdm_ctx, pdm_data, PDM_BUFFER_WORDS, pcm_data);
+}
+
+static void bench_pdm2pcm_decode_samples(void)
+{
+	sink = pdm2pcm_decode_samples(&pdm_ctx, pdm_data, PDM_BUFFER_WORDS, pcm_samples);
+}
+
+static void bench_adc_convert_block(void)
+{
+	adc_convert_block(&adc_ctx, adc_raw, &adc_block);
+	sink = adc_block.mean;
+}
+
+static void bench_decimator_process(void)
+{
+	sink = decimator_process(&decimator, samples, AUDIO_BLOCK_LEN, decimated);
+}
+
+static void bench_trigon_sinf(void)
+{
+	float sum = 0;
+
+	for(uint32_t i = 0; i < 64; i++) {
+		sum += sinf(0.1f * i);
+	}
+
+	sink = sum;
+}
+
+static const struct bench benches[] = {
+	{"fft_copy_windowed",           bench_fft_copy_windowed,       FFT_BLOCK_LEN},
+	{"fft_transform",               bench_fft_transform,           FFT_BLOCK_LEN},
+	{"fft_transform_real",          bench_fft_transform_real,      FFT_BLOCK_LEN},
+	{"fft_transform_real_inplace",  bench_fft_transform_real_inplace, FFT_BLOCK_LEN},
+	{"fft_complex_to_absolute",     bench_fft_complex_to_absolute, FFT_BLOCK_LEN},
+	{"fft_complex_to_power",        bench_fft_complex_to_power,    FFT_BLOCK_LEN},
+	{"fft_complex_to_absolute_approx", bench_fft_complex_to_absolute_approx, FFT_BLOCK_LEN},
+	{"fft_packed_to_absolute",      bench_fft_packed_to_absolute,  FFT_BLOCK_LEN},
+	{"fft_get_energy_in_band x6",   bench_fft_get_energy_in_band,  FFT_BLOCK_LEN},
+	{"filterbank (musiclight bands)", bench_filterbank_musiclight, FFT_BLOCK_LEN},
+	{"filterbank (32 mel bands)",   bench_filterbank_mel,          FFT_BLOCK_LEN},
+	{"float pipeline",              bench_float_pipeline,          FFT_BLOCK_LEN},
+	{"float pipeline (in-place)",   bench_float_pipeline_inplace,  FFT_BLOCK_LEN},
+	{"fft_q15_copy_windowed",       bench_q15_copy_windowed,       FFT_BLOCK_LEN},
+	{"fft_q15_transform_real",      bench_q15_transform_real,      FFT_BLOCK_LEN},
+	{"fft_q15_load_windowed",       bench_q15_load_windowed,       FFT_BLOCK_LEN},
+	{"fft_q15_complex_to_absolute", bench_q15_complex_to_absolute, FFT_BLOCK_LEN},
+	{"fft_q15_get_energy_in_band x6", bench_q15_get_energy_in_band, FFT_BLOCK_LEN},
+	{"q15 pipeline",                bench_q15_pipeline,            FFT_BLOCK_LEN},
+	{"q15 pipeline (fused window)", bench_q15_pipeline_fused,      FFT_BLOCK_LEN},
+	{"sdft_update x64",             bench_sdft_update,             STFT_HOP_SIZE},
+	{"sdft_get_absolute",           bench_sdft_get_absolute,       0},
+	{"sdft_get_energy_in_band x6",  bench_sdft_get_energy_in_band, 0},
+	{"pdm2pcm_decode 64 words",     bench_pdm2pcm_decode,          PDM_BUFFER_WORDS * 32.0 / PDM_OVERSAMPLING},
+	{"pdm2pcm_decode_samples 64 words", bench_pdm2pcm_decode_samples, PDM_BUFFER_WORDS * 32.0 / PDM_OVERSAMPLING},
+	{"adc_convert_block",           bench_adc_convert_block,       AUDIO_BLOCK_LEN},
+	{"decimator_process 64",        bench_decimator_process,       AUDIO_BLOCK_LEN},
+	{"trigon sinf x64",             bench_trigon_sinf,             0},
+};
+
+/*** infrastructure ***/
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void init_inputs(void)
+{
+	// music-like test signal: a few tones plus some noise
+	srand(42);
+	for(int i = 0; i < FFT_BLOCK_LEN; i++) {
+		double t = (double)i / SAMPLE_RATE;
+		double v = 0.3 * sin(2 * M_PI * 110 * t)
+			+ 0.2 * sin(2 * M_PI * 1234 * t)
+			+ 0.1 * sin(2 * M_PI * 6000 * t)
+			+ 0.05 * ((double)rand() / RAND_MAX - 0.5);
+
+		q15_samples[i] = (int16_t)(v * 32767);
+		if(i < AUDIO_BLOCK_LEN) {
+			adc_raw[i] = (uint16_t)(2048 + v * 2047);
+		}
+#ifdef FFT_FIXED_POINT
+		samples[i] = q15_samples[i];
+#else
+		samples[i] = v;
+#endif
+	}
+
+	// PDM bitstream of a 1 kHz tone from a first order sigma-delta modulator
+	double integrator = 0;
+	for(int w = 0; w < PDM_BUFFER_WORDS; w++) {
+		uint32_t word = 0;
+		for(int b = 0; b < 32; b++) {
+			double t = (w * 32.0 + b) / (SAMPLE_RATE * PDM_OVERSAMPLING);
+			double v = 0.5 * sin(2 * M_PI * 1000 * t);
+			int bit = integrator >= 0;
+
+			integrator += v - (bit ? 1 : -1);
+			word |= (uint32_t)bit << (b < 16 ? 15 - b : 47 - b); // like the I2S DMA
+		}
+		pdm_data[w] = word;
+	}
+
+	filterbank_init(&fb_musiclight, musiclight_bands,
+			sizeof(musiclight_bands) / sizeof(musiclight_bands[0]));
+	filterbank_init_spaced(&fb_mel, 32, 50, 10000, FILTERBANK_MEL);
+
+	sdft_init(&sdft);
+	pdm2pcm_init(&pdm_ctx, PDM_OVERSAMPLING);
+	adc_convert_init(&adc_ctx, ADC_DC_CORNER_FREQ);
+	decimator_init(&decimator);
+
+	// run the pipelines once so every stage has valid input
+	bench_float_pipeline_inplace();
+	bench_float_pipeline();
+	bench_q15_pipeline();
+}
+
+static void run_bench(const struct bench *b, double min_time)
+{
+	uint64_t batch = 1;
+	double best = INFINITY;
+
+	// warm up and find a batch size that takes about 1/10 of min_time
+	for(;;) {
+		double start = now();
+		for(uint64_t i = 0; i < batch; i++) {
+			b->run();
+		}
+		if(now() - start > min_time / 10) {
+			break;
+		}
+		batch *= 2;
+	}
+
+	// take the fastest batch (least disturbed by the system)
+	double total_start = now();
+	while(now() - total_start < min_time) {
+		double start = now();
+		for(uint64_t i = 0; i < batch; i++) {
+			b->run();
+		}
+		double t = (now() - start) / batch;
+		if(t < best) {
+			best = t;
+		}
+	}
+
+	printf("%-32s %12.1f %14.0f", b->name, best * 1e9, 1.0 / best);
+
+	if(b->samples_per_call > 0) {
+		printf(" %12.1f\n", b->samples_per_call / SAMPLE_RATE / best);
+	} else {
+		printf(" %12s\n", "-");
+	}
+}
+
+int main(int argc, char **argv)
+{
+	double min_time = 0.5;
+
+	if(argc > 1) {
+		min_time = atof(argv[1]);
+	}
+
+	init_inputs();
+
+	printf("FFT_BLOCK_LEN %d, SAMPLE_RATE %d, FFT_KERNEL %s\n\n", FFT_BLOCK_LEN, SAMPLE_RATE,
+			FFT_KERNEL == FFT_KERNEL_RADIX4 ? "radix-4" : "radix-2");
+	printf("%-32s %12s %14s %12s\n", "stage", "ns/call", "calls/s", "realtime");
+
+	for(size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+		run_bench(&benches[i], min_time);
+	}
+
+	return 0;
+}
@@ -0,0 +1,208 @@
+/*
+ * Offline replay: run a recording through the same code as the firmware
+ * (sample conversion, analysis, effect and LED message) as fast as possible
+ * and write the LED frames to a file.
+ *
+ * The time seen by the effect and the LED output is derived from the sample
+ * position, so the output only depends on the input and can be compared
+ * between builds. The frames are rendered at LED_FRAME_RATE like in the
+ * firmware.
+ *
+ * Usage: replay [-f pcm|wav|pdm] [-e musiclight|mono|sinusfader] [-o output] input
+ *
+ * Output formats (chosen by the name of the output file):
+ * - *.csv: one line per frame, the time in ms and r,g,b (0..255) per module
+ * - otherwise: per frame the time in ms (32 bit little endian) followed by
+ *   the message in wire format (see ws2801_get_message())
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "audio_source.h"
+#include "audio_file.h"
+#include "musiclight.h"
+#include "ws2801.h"
+#include "led_output.h"
+
+static FILE *out = NULL;
+static int out_csv = 0;
+
+static uint32_t cur_tick = 0;
+static uint32_t cur_us = 0;
+static uint32_t frames = 0;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// the clock of the LED output
+static uint32_t replay_clock(void)
+{
+	return cur_us;
+}
+
+// called by the LED output instead of the SPI/DMA transfer of the firmware;
+// the frame is written at once, so the back buffer is always free
+enum ws2801_send_status ws2801_send_update(void)
+{
+	const uint8_t *message = ws2801_get_message();
+
+	frames++;
+
+	if(!out) {
+		return WS2801_SENT;
+	}
+
+	if(out_csv) {
+		fprintf(out, "%u", (unsigned)cur_tick);
+
+		// wire format is RBG
+		for(uint32_t i = 0; i < WS2801_NUM_MODULES; i++) {
+			fprintf(out, ",%u,%u,%u", message[3*i + 0], message[3*i + 2], message[3*i + 1]);
+		}
+
+		fputc('\n', out);
+	} else {
+		for(int i = 0; i < 4; i++) {
+			fputc((cur_tick >> (8 * i)) & 0xFF, out);
+		}
+
+		fwrite(message, 1, 3 * WS2801_NUM_MODULES, out);
+	}
+
+	return WS2801_SENT;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-f pcm|wav|pdm] [-e musiclight|mono|sinusfader] [-o output] input\n",
+			prog);
+}
+
+int main(int argc, char **argv)
+{
+	const struct audio_source *src = &audio_source_file;
+	enum audio_file_format format = AUDIO_FILE_WAV;
+	musiclight_effect effect = musiclight;
+	const char *out_path = NULL;
+	uint32_t blocks = 0;
+	int opt;
+
+	while((opt = getopt(argc, argv, "f:e:o:")) != -1) {
+		switch(opt) {
+			case 'f':
+				if(strcmp(optarg, "pcm") == 0) {
+					format = AUDIO_FILE_PCM16;
+				} else if(strcmp(optarg, "wav") == 0) {
+					format = AUDIO_FILE_WAV;
+				} else if(strcmp(optarg, "pdm") == 0) {
+					format = AUDIO_FILE_PDM;
+				} else {
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'e':
+				if(strcmp(optarg, "musiclight") == 0) {
+					effect = musiclight;
+				} else if(strcmp(optarg, "mono") == 0) {
+					effect = musiclight_mono;
+				} else if(strcmp(optarg, "sinusfader") == 0) {
+					effect = sinusfader;
+				} else {
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'o':
+				out_path = optarg;
+				break;
+
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if(optind != argc - 1) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if(audio_file_open(argv[optind], format) != 0) {
+		fprintf(stderr, "cannot read %s\n", argv[optind]);
+		return 1;
+	}
+
+	if(out_path) {
+		size_t len = strlen(out_path);
+
+		out_csv = len >= 4 && strcmp(out_path + len - 4, ".csv") == 0;
+		out = fopen(out_path, out_csv ? "w" : "wb");
+		if(!out) {
+			fprintf(stderr, "cannot write %s\n", out_path);
+			audio_file_close();
+			return 1;
+		}
+	}
+
+	led_output_init(replay_clock);
+	musiclight_init();
+	src->init();
+	src->start();
+
+	double start = now();
+	uint64_t next_frame_us = 1000000 / LED_FRAME_RATE;
+
+	for(const struct audio_block *block; (block = src->get_block()) != NULL; blocks++) {
+		// the time at the end of the block
+		uint64_t end_us = (uint64_t)(block->timestamp + AUDIO_BLOCK_LEN) * 1000000 / SAMPLE_RATE;
+
+		// the frames due while the block was recorded
+		while(next_frame_us < end_us) {
+			cur_us = next_frame_us;
+			cur_tick = next_frame_us / 1000;
+			led_output_render();
+
+			next_frame_us += 1000000 / LED_FRAME_RATE;
+		}
+
+		cur_us = end_us;
+		cur_tick = end_us / 1000;
+
+		musiclight_push_block(block);
+		src->release_block();
+
+		// the firmware interleaves the steps with the audio input, here the
+		// update is completed before the next block
+		while(musiclight_process(effect, cur_tick));
+	}
+
+	double wall = now() - start;
+	double audio_time = (double)blocks * AUDIO_BLOCK_LEN / SAMPLE_RATE;
+
+	src->stop();
+	audio_file_close();
+
+	if(out) {
+		fclose(out);
+	}
+
+	printf("%u blocks, %u frames, %.2f s audio in %.3f s, realtime factor %.1f\n",
+			(unsigned)blocks, (unsigned)frames, audio_time, wall,
+			wall > 0 ? audio_time / wall : 0.0);
+
+	return 0;
+}
@@ -0,0 +1,160 @@
+/*
+ * Host test for the ADC sample conversion: selection of the DC removal corner
+ * frequency, convergence from the first block, step response, passband gain
+ * and the published block mean.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "config.h"
+#include "adc_convert.h"
+
+#define TEST_PI 3.14159265358979
+
+// blocks per second
+#define BLOCK_RATE ((double)SAMPLE_RATE / AUDIO_BLOCK_LEN)
+
+static int failures = 0;
+
+static void check(int cond, const char *what)
+{
+	if(!cond) {
+		printf("FAIL %s\n", what);
+		failures++;
+	}
+}
+
+// converted sample in ADC LSB
+static double to_lsb(double s)
+{
+#ifdef FFT_FIXED_POINT
+	return s / (1 << (15 - ADC_BITS));
+#else
+	return s * (1 << ADC_BITS);
+#endif
+}
+
+static struct adc_convert_ctx ctx;
+static struct audio_block block;
+static uint32_t sample_idx;
+
+/*
+ * Convert the next block of offset + amplitude * sin(2 pi freq t). Returns the
+ * mean of the output in LSB and checks the published mean.
+ */
+static double convert(double offset, double amplitude, double freq, double *power)
+{
+	uint16_t raw[AUDIO_BLOCK_LEN];
+	double sum = 0, sum2 = 0;
+
+	for(uint32_t i = 0; i < AUDIO_BLOCK_LEN; i++, sample_idx++) {
+		raw[i] = (uint16_t)lround(offset + amplitude * sin(2 * TEST_PI * freq * sample_idx / SAMPLE_RATE));
+	}
+
+	adc_convert_block(&ctx, raw, &block);
+
+	for(uint32_t i = 0; i < AUDIO_BLOCK_LEN; i++) {
+		double v = to_lsb(block.samples[i]);
+		sum += v;
+		sum2 += v * v;
+	}
+
+	if(fabs(to_lsb(block.mean) - sum / AUDIO_BLOCK_LEN) > 1e-3) {
+		check(0, "published block mean");
+	}
+
+	if(power) {
+		*power = sum2 / AUDIO_BLOCK_LEN;
+	}
+
+	return sum / AUDIO_BLOCK_LEN;
+}
+
+static void test_init(void)
+{
+	check(adc_convert_init(&ctx, 0) == -1, "corner frequency 0 rejected");
+	check(adc_convert_init(&ctx, 1000) == -1, "too high corner frequency rejected");
+	check(adc_convert_init(&ctx, 1e-6f) == -1, "too low corner frequency rejected");
+
+	// block rate / (2 pi 2^shift) must be within a factor of sqrt(2)
+	for(float f = 0.01f; f < 30; f *= 1.3f) {
+		check(adc_convert_init(&ctx, f) == 0, "corner frequency accepted");
+
+		double actual = BLOCK_RATE / (2 * TEST_PI * (1 << ctx.shift));
+		check(actual < f * 1.415 && actual > f / 1.415, "corner frequency rounding");
+	}
+}
+
+static void test_startup(void)
+{
+	double power;
+
+	adc_convert_init(&ctx, ADC_DC_CORNER_FREQ);
+	sample_idx = 0;
+
+	// the offset is removed from the first block on (1 kHz is a multiple of
+	// the block rate, so every block has a mean of zero)
+	for(int i = 0; i < 100; i++) {
+		double mean = convert(3000, 500, BLOCK_RATE * 2, &power);
+
+		if(fabs(mean) > 1.0) {
+			printf("block %d: mean %.2f LSB\n", i, mean);
+			check(0, "offset removed from the start");
+			break;
+		}
+	}
+
+	check(fabs(sqrt(power) - 500 / sqrt(2)) < 0.01 * 500, "passband gain");
+}
+
+static void test_step(void)
+{
+	double mean;
+	int blocks;
+
+	adc_convert_init(&ctx, ADC_DC_CORNER_FREQ);
+	sample_idx = 0;
+
+	for(int i = 0; i < 2000; i++) {
+		convert(3000, 0, 0, NULL);
+	}
+
+	// a step in the offset decays with the time constant of the highpass
+	mean = convert(2000, 0, 0, NULL);
+	check(fabs(mean + 1000) < 1, "step passes the highpass");
+
+	for(blocks = 1; blocks < 10 * BLOCK_RATE; blocks++) {
+		mean = convert(2000, 0, 0, NULL);
+		if(mean > -1000 * exp(-1)) {
+			break;
+		}
+	}
+
+	// time constant: 1 / (2 pi corner frequency) = 2^shift blocks
+	double tau = blocks / BLOCK_RATE;
+	double expected = (1 << ctx.shift) / BLOCK_RATE;
+	printf("step response: time constant %.3f s (expected %.3f s)\n", tau, expected);
+	check(tau > 0.8 * expected && tau < 1.2 * expected, "step response time constant");
+
+	for(int i = 0; i < 20 * (1 << ctx.shift); i++) {
+		mean = convert(2000, 0, 0, NULL);
+	}
+	check(fabs(mean) <= 0.5, "offset removed after the step");
+}
+
+int main(void)
+{
+	test_init();
+	test_startup();
+	test_step();
+
+	if(failures) {
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
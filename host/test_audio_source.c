@@ -0,0 +1,226 @@
+/*
+ * Host test for the audio source block queue and the file source: order,
+ * timestamps and dropped blocks, reading PCM, WAV and PDM recordings.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <math.h>
+
+#include "config.h"
+#include "audio_source.h"
+#include "audio_file.h"
+#include "adc_convert.h"
+
+static int failures = 0;
+
+static void check(int cond, const char *what)
+{
+	if(!cond) {
+		printf("FAIL %s\n", what);
+		failures++;
+	}
+}
+
+static double sample_value(fft_sample s)
+{
+#ifdef FFT_FIXED_POINT
+	return s / 32768.0;
+#else
+	return s;
+#endif
+}
+
+static void test_queue(void)
+{
+	static struct audio_queue queue;
+	struct audio_block *block;
+	const struct audio_block *out;
+
+	audio_queue_init(&queue);
+	check(audio_queue_peek(&queue) == NULL, "peek into empty queue");
+
+	for(int i = 0; i < AUDIO_QUEUE_BLOCKS; i++) {
+		block = audio_queue_begin_write(&queue);
+		check(block != NULL, "begin_write into free queue");
+		block->samples[0] = i;
+		audio_queue_commit(&queue);
+	}
+
+	// the next block is lost, but its samples are still counted
+	check(audio_queue_begin_write(&queue) == NULL, "begin_write into full queue");
+	check(audio_queue_get_dropped(&queue) == 1, "dropped counter");
+
+	out = audio_queue_peek(&queue);
+	check(out && out->samples[0] == 0 && out->timestamp == 0, "oldest block first");
+	audio_queue_release(&queue);
+
+	block = audio_queue_begin_write(&queue);
+	check(block && block->timestamp == (AUDIO_QUEUE_BLOCKS + 1) * AUDIO_BLOCK_LEN,
+			"timestamp after a dropped block");
+	audio_queue_commit(&queue);
+
+	for(int i = 1; i < AUDIO_QUEUE_BLOCKS; i++) {
+		out = audio_queue_peek(&queue);
+		check(out && out->samples[0] == i && out->timestamp == (uint32_t)i * AUDIO_BLOCK_LEN,
+				"blocks in order");
+		audio_queue_release(&queue);
+	}
+
+	check(audio_queue_peek(&queue) != NULL, "block after the wrap");
+	audio_queue_release(&queue);
+	check(audio_queue_peek(&queue) == NULL, "queue empty again");
+}
+
+static int16_t pcm_value(uint32_t i)
+{
+	return (int16_t)(i * 97 - 16000);
+}
+
+static void put_le(FILE *f, uint32_t v, int bytes)
+{
+	for(int i = 0; i < bytes; i++) {
+		fputc((v >> (8 * i)) & 0xFF, f);
+	}
+}
+
+/*
+ * Write 3.5 blocks of pcm_value() as raw PCM or as a stereo WAV file (with an
+ * extra chunk before the data) and read them back. The samples must be the
+ * same as from the ADC conversion.
+ */
+static void test_file_pcm(const char *path, enum audio_file_format format)
+{
+	const struct audio_source *src = &audio_source_file;
+	const uint32_t nsamples = 3 * AUDIO_BLOCK_LEN + AUDIO_BLOCK_LEN / 2;
+	const char *name = format == AUDIO_FILE_WAV ? "WAV" : "PCM";
+	FILE *f = fopen(path, "wb");
+	struct adc_convert_ctx adc;
+	uint32_t nblocks = 0;
+	int ok = 1;
+	char what[64];
+
+	if(format == AUDIO_FILE_WAV) {
+		fputs("RIFF", f);
+		put_le(f, 4 + 8 + 16 + 8 + 4 + 8 + 4 * nsamples, 4);
+		fputs("WAVEfmt ", f);
+		put_le(f, 16, 4);
+		put_le(f, 1, 2);                   // PCM
+		put_le(f, 2, 2);                   // channels
+		put_le(f, SAMPLE_RATE, 4);
+		put_le(f, 4 * SAMPLE_RATE, 4);     // bytes per second
+		put_le(f, 4, 2);                   // bytes per frame
+		put_le(f, 16, 2);                  // bits per sample
+		fputs("LIST", f);
+		put_le(f, 4, 4);
+		fputs("INFO", f);
+		fputs("data", f);
+		put_le(f, 4 * nsamples, 4);
+	}
+
+	for(uint32_t i = 0; i < nsamples; i++) {
+		put_le(f, (uint16_t)pcm_value(i), 2);
+
+		if(format == AUDIO_FILE_WAV) {
+			put_le(f, 0x7FFF, 2); // second channel, ignored
+		}
+	}
+	fclose(f);
+
+	snprintf(what, sizeof(what), "open %s file", name);
+	check(audio_file_open(path, format) == 0, what);
+	src->init();
+	check(src->get_block() == NULL, "block before start()");
+	src->start();
+
+	adc_convert_init(&adc, ADC_DC_CORNER_FREQ);
+
+	for(const struct audio_block *block; (block = src->get_block()) != NULL; nblocks++) {
+		uint16_t raw[AUDIO_BLOCK_LEN];
+		struct audio_block expected;
+
+		ok &= block->timestamp == nblocks * AUDIO_BLOCK_LEN;
+
+		for(uint32_t i = 0; i < AUDIO_BLOCK_LEN; i++) {
+			raw[i] = (uint16_t)(pcm_value(block->timestamp + i) + 32768) >> (16 - ADC_BITS);
+		}
+
+		adc_convert_block(&adc, raw, &expected);
+		ok &= memcmp(block->samples, expected.samples, sizeof(expected.samples)) == 0;
+		ok &= block->mean == expected.mean;
+
+		src->release_block();
+	}
+
+	snprintf(what, sizeof(what), "%s samples or timestamps wrong", name);
+	check(ok, what);
+	check(nblocks == 3, "partial block not discarded");
+	check(src->get_dropped() == 0, "blocks dropped");
+
+	audio_file_close();
+}
+
+static void test_file_pdm(const char *path)
+{
+	const struct audio_source *src = &audio_source_file;
+	FILE *f = fopen(path, "wb");
+	const struct audio_block *block = NULL;
+
+	// a stream of ones is positive full scale
+	for(uint32_t i = 0; i < 4 * AUDIO_BLOCK_LEN * 2; i++) {
+		uint32_t word = 0xFFFFFFFF;
+		fwrite(&word, sizeof(word), 1, f);
+	}
+	fclose(f);
+
+	check(audio_file_open(path, AUDIO_FILE_PDM) == 0, "open PDM file");
+	src->init();
+	src->start();
+
+	for(int i = 0; i < 4; i++) {
+		block = src->get_block();
+		check(block != NULL, "PDM block");
+		if(i < 3) {
+			src->release_block();
+		}
+	}
+
+	check(block && fabs(sample_value(block->samples[AUDIO_BLOCK_LEN - 1]) - 1.0) < 1e-4,
+			"PDM full scale");
+	check(block && fabs(sample_value(block->mean) - 1.0) < 1e-4, "PDM block mean");
+
+	audio_file_close();
+}
+
+int main(void)
+{
+	char path[] = "/tmp/test_audio_source.XXXXXX";
+	int fd = mkstemp(path);
+
+	test_queue();
+
+	check(fd >= 0, "temporary file");
+	if(fd >= 0) {
+		close(fd);
+		test_file_pcm(path, AUDIO_FILE_PCM16);
+		test_file_pcm(path, AUDIO_FILE_WAV);
+		test_file_pdm(path);
+
+		// the PDM data left in the file is no WAV file
+		check(audio_file_open(path, AUDIO_FILE_WAV) == -1, "open invalid WAV file");
+		unlink(path);
+	}
+
+	check(audio_file_open("/nonexistent/file", AUDIO_FILE_PCM16) == -1, "open missing file");
+
+	if(failures) {
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
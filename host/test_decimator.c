@@ -0,0 +1,135 @@
+/*
+ * Host test for the decimator: gain in the passband of the low bands,
+ * rejection of everything that aliases into them, number and timing of the
+ * output samples.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "config.h"
+#include "fft/decimator.h"
+
+#define TEST_PI 3.14159265358979
+
+// output samples analysed: 0.2 s, so all test frequencies (multiples of
+// 5 Hz) have an integer number of periods
+#define TEST_OUT_LEN   (DECIMATOR_SAMPLE_RATE / 5)
+
+// output samples skipped while the filter settles
+#define TEST_OUT_SKIP  DECIMATOR_TAPS
+
+// input samples per test signal, a multiple of the block lengths used
+#define TEST_LEN ((((TEST_OUT_LEN + TEST_OUT_SKIP) * DECIMATOR_FACTOR + 63) / 64) * 64)
+
+static int failures = 0;
+
+static void check(int cond, const char *what)
+{
+	if(!cond) {
+		printf("FAIL %s\n", what);
+		failures++;
+	}
+}
+
+static double sample_value(fft_sample s)
+{
+#ifdef FFT_FIXED_POINT
+	return s / 32768.0;
+#else
+	return s;
+#endif
+}
+
+/*
+ * Decimate a tone in blocks of block_len samples and return the amplitude of
+ * the output at the given output frequency (after the filter has settled).
+ */
+static double decimate_tone(double freq, double out_freq, uint32_t block_len)
+{
+	static struct decimator_ctx ctx;
+	static fft_sample in[TEST_LEN];
+	static fft_sample out[TEST_LEN / DECIMATOR_FACTOR + 1];
+	uint32_t count = 0;
+	double re = 0, im = 0;
+
+	for(uint32_t i = 0; i < TEST_LEN; i++) {
+		double v = 0.5 * sin(2 * TEST_PI * freq * i / SAMPLE_RATE);
+#ifdef FFT_FIXED_POINT
+		in[i] = (fft_sample)lrint(v * 32767);
+#else
+		in[i] = v;
+#endif
+	}
+
+	decimator_init(&ctx);
+
+	for(uint32_t i = 0; i < TEST_LEN; i += block_len) {
+		uint32_t n = TEST_LEN - i < block_len ? TEST_LEN - i : block_len;
+		count += decimator_process(&ctx, &in[i], n, &out[count]);
+	}
+
+	check(count == TEST_LEN / DECIMATOR_FACTOR, "number of output samples");
+	if(count < TEST_OUT_SKIP + TEST_OUT_LEN) {
+		return 0;
+	}
+
+	// correlate with the expected output frequency
+	uint32_t n = 0;
+
+	for(uint32_t k = TEST_OUT_SKIP; k < TEST_OUT_SKIP + TEST_OUT_LEN; k++, n++) {
+		double phase = 2 * TEST_PI * out_freq * k / DECIMATOR_SAMPLE_RATE;
+		re += sample_value(out[k]) * cos(phase);
+		im += sample_value(out[k]) * sin(phase);
+	}
+
+	return 2 * sqrt(re * re + im * im) / n / 0.5;
+}
+
+int main(void)
+{
+	double worst_pass = 0, worst_stop = -200;
+
+	// the low bands of musiclight() go up to 400 Hz
+	for(double f = 25; f <= 400; f += 25) {
+		double gain = 20 * log10(decimate_tone(f, f, 64));
+		if(fabs(gain) > fabs(worst_pass)) {
+			worst_pass = gain;
+		}
+	}
+
+	// tones that alias to 25 .. 400 Hz
+	for(int m = 1; m < DECIMATOR_FACTOR; m++) {
+		for(double f = 25; f <= 400; f += 25) {
+			double gain;
+
+			gain = 20 * log10(decimate_tone(m * DECIMATOR_SAMPLE_RATE - f, f, 64) + 1e-12);
+			if(gain > worst_stop) { worst_stop = gain; }
+
+			gain = 20 * log10(decimate_tone(m * DECIMATOR_SAMPLE_RATE + f, f, 64) + 1e-12);
+			if(gain > worst_stop) { worst_stop = gain; }
+		}
+	}
+
+	printf("passband 0-400 Hz: %.3f dB, aliases: %.1f dB\n", worst_pass, worst_stop);
+	check(fabs(worst_pass) < 0.2, "passband gain");
+#ifdef FFT_FIXED_POINT
+	check(worst_stop < -60, "alias rejection");
+#else
+	check(worst_stop < -70, "alias rejection");
+#endif
+
+	// the block length does not matter
+	check(fabs(decimate_tone(200, 200, 1) - decimate_tone(200, 200, 64)) < 1e-6
+			&& fabs(decimate_tone(200, 200, 13) - decimate_tone(200, 200, 64)) < 1e-6,
+			"same output for any block length");
+
+	if(failures) {
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
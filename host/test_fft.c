@@ -0,0 +1,198 @@
+/*
+ * Host test for the float FFT functions: the transforms are compared against
+ * a double precision DFT.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "config.h"
+#include "fft/fft.h"
+
+static int failures = 0;
+
+static double ref_re[FFT_DATALEN];
+static double ref_im[FFT_DATALEN];
+
+static void check(int cond, const char *name, const char *what)
+{
+	if(!cond) {
+		printf("FAIL %s: %s\n", name, what);
+		failures++;
+	}
+}
+
+static void reference_dft(const fft_sample *x)
+{
+	for(int k = 0; k < FFT_DATALEN; k++) {
+		ref_re[k] = 0;
+		ref_im[k] = 0;
+
+		for(int n = 0; n < FFT_BLOCK_LEN; n++) {
+			ref_re[k] += x[n] * cos(2 * M_PI * k * n / FFT_BLOCK_LEN);
+			ref_im[k] -= x[n] * sin(2 * M_PI * k * n / FFT_BLOCK_LEN);
+		}
+	}
+}
+
+/*
+ * Maximum deviation relative to the largest reference magnitude. If
+ * magnitude_only is set, only the magnitudes are compared.
+ */
+static double compare(const fft_value_type *re, const fft_value_type *im, int magnitude_only)
+{
+	double peak = 0, err = 0;
+
+	for(int k = 0; k < FFT_DATALEN; k++) {
+		double mag = hypot(ref_re[k], ref_im[k]);
+		double e;
+
+		if(magnitude_only) {
+			e = fabs(mag - hypot(re[k], im[k]));
+		} else {
+			e = hypot(ref_re[k] - re[k], ref_im[k] - im[k]);
+		}
+
+		if(mag > peak) { peak = mag; }
+		if(e > err) { err = e; }
+	}
+
+	return peak > 0 ? err / peak : err;
+}
+
+/*
+ * The magnitude modes against each other: power must be the square of the
+ * exact magnitude, the estimate must stay within its 3.96 % error bound.
+ */
+static void check_magnitudes(const char *name, fft_value_type *re, fft_value_type *im)
+{
+	static fft_value_type mag[FFT_DATALEN], power[FFT_DATALEN], approx[FFT_DATALEN];
+	double power_err = 0, approx_err = 0;
+
+	fft_complex_to_absolute(re, im, mag);
+	fft_complex_to_power(re, im, power);
+	fft_complex_to_absolute_approx(re, im, approx);
+
+	for(int k = 0; k < FFT_DATALEN; k++) {
+		double exact = hypot(re[k], im[k]);
+
+		if(exact > 0) {
+			double e = fabs(power[k] - exact * exact) / (exact * exact);
+			if(e > power_err) { power_err = e; }
+
+			e = fabs(approx[k] - exact) / exact;
+			if(e > approx_err) { approx_err = e; }
+		}
+
+		check(fabs(mag[k] - exact) <= 1e-6 * exact, name, "fft_complex_to_absolute()");
+	}
+
+	check(power_err < 1e-6, name, "fft_complex_to_power()");
+	check(approx_err < 0.0397, name, "fft_complex_to_absolute_approx()");
+	printf("%-12s approx. magnitude    %.2f %%\n", name, 100 * approx_err);
+}
+
+/*
+ * The in-place transform against the reference, and the packed magnitude
+ * functions against the ones for separate arrays.
+ */
+static void check_inplace(const char *name, const fft_sample *x)
+{
+	static fft_value_type buf[FFT_BLOCK_LEN];
+	static fft_value_type re[FFT_DATALEN], im[FFT_DATALEN];
+	static fft_value_type mag[FFT_DATALEN], packed_mag[FFT_DATALEN];
+	double err;
+
+	for(int i = 0; i < FFT_BLOCK_LEN; i++) {
+		buf[i] = x[i];
+	}
+
+	fft_transform_real_inplace(buf);
+
+	re[0] = buf[0];
+	im[0] = 0;
+	re[FFT_BLOCK_LEN/2] = buf[1];
+	im[FFT_BLOCK_LEN/2] = 0;
+	for(int k = 1; k < FFT_BLOCK_LEN/2; k++) {
+		int r = lookup_table[k] >> 1;
+
+		re[k] = buf[2*r];
+		im[k] = buf[2*r + 1];
+	}
+
+	err = compare(re, im, 0);
+	check(err < 1e-5, name, "fft_transform_real_inplace()");
+	printf("%-12s fft_transform_real_inplace  %.2e\n", name, err);
+
+	fft_complex_to_absolute(re, im, mag);
+	fft_packed_to_absolute(buf, packed_mag);
+	for(int k = 0; k < FFT_DATALEN; k++) {
+		check(fabs(mag[k] - packed_mag[k]) <= 1e-6 * mag[k], name, "fft_packed_to_absolute()");
+	}
+
+	fft_complex_to_power(re, im, mag);
+	fft_packed_to_power(buf, packed_mag);
+	for(int k = 0; k < FFT_DATALEN; k++) {
+		check(fabs(mag[k] - packed_mag[k]) <= 1e-6 * mag[k], name, "fft_packed_to_power()");
+	}
+
+	fft_complex_to_absolute_approx(re, im, mag);
+	fft_packed_to_absolute_approx(buf, packed_mag);
+	for(int k = 0; k < FFT_DATALEN; k++) {
+		check(fabs(mag[k] - packed_mag[k]) <= 1e-6 * mag[k], name, "fft_packed_to_absolute_approx()");
+	}
+}
+
+static void run_case(const char *name, const fft_sample *x)
+{
+	static fft_value_type re[FFT_BLOCK_LEN], im[FFT_BLOCK_LEN];
+	double err;
+
+	reference_dft(x);
+
+	// the legacy kernel only gives correct magnitudes
+	fft_transform((fft_sample *)x, re, im);
+	err = compare(re, im, 1);
+	check(err < 1e-5, name, "fft_transform() magnitudes");
+	printf("%-12s fft_transform       %.2e\n", name, err);
+
+	fft_transform_real((fft_sample *)x, re, im);
+	err = compare(re, im, 0);
+	check(err < 1e-5, name, "fft_transform_real()");
+	printf("%-12s fft_transform_real  %.2e\n", name, err);
+
+	check_magnitudes(name, re, im);
+
+	check_inplace(name, x);
+}
+
+int main(void)
+{
+	static fft_sample x[FFT_BLOCK_LEN];
+
+	for(int i = 0; i < FFT_BLOCK_LEN; i++) {
+		x[i] = sin(2 * M_PI * 17.3 * i / FFT_BLOCK_LEN);
+	}
+	run_case("sine", x);
+
+	for(int i = 0; i < FFT_BLOCK_LEN; i++) {
+		x[i] = (i & 1) ? -1 : 1;
+	}
+	run_case("nyquist", x);
+
+	srand(1);
+	for(int i = 0; i < FFT_BLOCK_LEN; i++) {
+		x[i] = (double)rand() / RAND_MAX - 0.5;
+	}
+	run_case("noise", x);
+
+	if(failures) {
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
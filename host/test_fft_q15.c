@@ -0,0 +1,315 @@
+/*
+ * Host test for the Q15 FFT pipeline.
+ *
+ * The packed implementation (using the portable C fallback of the DSP
+ * instructions) is compared bit by bit against a straightforward scalar
+ * reference of the same algorithm, and its accuracy is checked against a
+ * double precision DFT.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "config.h"
+#include "fft/fft.h"
+#include "fft/fft_q15.h"
+
+#define NUM_CPLX (FFT_BLOCK_LEN/2)
+
+struct cplx {
+	int32_t re, im;
+};
+
+static int failures = 0;
+
+// summary over all cases with a signal
+static int num_cases = 0;
+static double worst_snr = INFINITY;
+static double worst_error = 0;
+
+/*** scalar reference ***/
+
+static int32_t ref_sat(int32_t x)
+{
+	return x > 32767 ? 32767 : (x < -32768 ? -32768 : x);
+}
+
+// OR of |x| (x >= 0) and |x|-1 (x < 0) over all values
+static int32_t ref_bit_pattern(const struct cplx *d, int n)
+{
+	int32_t pattern = 0;
+
+	for(int i = 0; i < n; i++) {
+		pattern |= (d[i].re >= 0) ? d[i].re : -d[i].re - 1;
+		pattern |= (d[i].im >= 0) ? d[i].im : -d[i].im - 1;
+	}
+
+	return pattern;
+}
+
+static int ref_needs_scaling(const struct cplx *d, int n, int32_t limit)
+{
+	for(int i = 0; i < n; i++) {
+		if(d[i].re > limit || d[i].re < -limit-1 || d[i].im > limit || d[i].im < -limit-1) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static struct cplx ref_twiddle(int m)
+{
+	struct cplx w = {q15_lo(fft_q15_twiddles[m]), q15_hi(fft_q15_twiddles[m])};
+	return w;
+}
+
+static struct cplx ref_mul(struct cplx a, struct cplx w)
+{
+	struct cplx r = {(a.re * w.re - a.im * w.im) >> 15, (a.re * w.im + a.im * w.re) >> 15};
+	return r;
+}
+
+static struct cplx ref_add(struct cplx a, struct cplx b, int scale)
+{
+	struct cplx r;
+
+	if(scale) {
+		r.re = (a.re + b.re) >> 1;
+		r.im = (a.im + b.im) >> 1;
+	} else {
+		r.re = ref_sat(a.re + b.re);
+		r.im = ref_sat(a.im + b.im);
+	}
+
+	return r;
+}
+
+static struct cplx ref_sub(struct cplx a, struct cplx b, int scale)
+{
+	struct cplx nb = {-b.re, -b.im};
+	return ref_add(a, nb, scale);
+}
+
+static int ref_transform(const int16_t *x, struct cplx *d)
+{
+	int exponent = 0;
+	int scale;
+
+	for(int i = 0; i < NUM_CPLX; i++) {
+		int r = 0;
+		for(int b = 0; b < FFT_EXPONENT-1; b++) {
+			r |= ((i >> b) & 1) << (FFT_EXPONENT - b - 2);
+		}
+
+		d[r].re = x[2*i];
+		d[r].im = x[2*i+1];
+	}
+
+	if(ref_needs_scaling(d, NUM_CPLX, 16383)) {
+		for(int i = 0; i < NUM_CPLX; i++) {
+			d[i].re >>= 1;
+			d[i].im >>= 1;
+		}
+		exponent++;
+	} else {
+		// normalise: largest shift that keeps the bit pattern within 14 bits
+		int32_t pattern = ref_bit_pattern(d, NUM_CPLX);
+
+		int shift = 0;
+		while(((pattern + 1) << (shift + 1)) <= 16384) {
+			shift++;
+		}
+
+		for(int i = 0; i < NUM_CPLX; i++) {
+			d[i].re *= 1 << shift;
+			d[i].im *= 1 << shift;
+		}
+		exponent -= shift;
+	}
+
+	for(int layer = 0; layer < FFT_EXPONENT-1; layer++) {
+		int span = 1 << layer;
+
+		scale = ref_needs_scaling(d, NUM_CPLX, 8191);
+		exponent += scale;
+
+		for(int g = 0; g < NUM_CPLX; g += 2*span) {
+			for(int e = 0; e < span; e++) {
+				struct cplx t = ref_mul(d[g+e+span], ref_twiddle(e * (NUM_CPLX / span)));
+				struct cplx l = d[g+e];
+
+				d[g+e] = ref_add(l, t, scale);
+				d[g+e+span] = ref_sub(l, t, scale);
+			}
+		}
+	}
+
+	scale = ref_needs_scaling(d, NUM_CPLX, 8191);
+	exponent += scale;
+
+	struct cplx z0 = d[0];
+	d[0].re = ref_sat((z0.re + z0.im) >> scale);
+	d[0].im = 0;
+	d[NUM_CPLX].re = ref_sat((z0.re - z0.im) >> scale);
+	d[NUM_CPLX].im = 0;
+
+	for(int k = 1; k <= NUM_CPLX/2; k++) {
+		struct cplx a = d[k];
+		struct cplx bc = {d[NUM_CPLX-k].re, ref_sat(-d[NUM_CPLX-k].im)};
+
+		struct cplx e = {(a.re + bc.re) >> 1, (a.im + bc.im) >> 1};
+		struct cplx h = {(a.re - bc.re) >> 1, (a.im - bc.im) >> 1};
+		struct cplx o = {h.im, ref_sat(-h.re)};
+		struct cplx wo = ref_mul(o, ref_twiddle(k));
+
+		struct cplx xk = ref_add(e, wo, scale);
+		struct cplx y = ref_sub(e, wo, scale);
+
+		d[k] = xk;
+		d[NUM_CPLX-k].re = y.re;
+		d[NUM_CPLX-k].im = ref_sat(-y.im);
+	}
+
+	return exponent;
+}
+
+/*** test cases ***/
+
+static void check(int cond, const char *name, const char *what)
+{
+	if(!cond) {
+		printf("FAIL %s: %s\n", name, what);
+		failures++;
+	}
+}
+
+static void run_case(const char *name, const int16_t *input)
+{
+	static int16_t windowed[FFT_BLOCK_LEN];
+	static uint32_t packed[FFT_DATALEN];
+	static uint32_t absval[FFT_DATALEN];
+	static struct cplx ref[FFT_DATALEN];
+	int failures_before = failures;
+
+	fft_q15_copy_windowed(input, windowed);
+
+	int exponent = fft_q15_transform_real(windowed, packed);
+	int ref_exponent = ref_transform(windowed, ref);
+
+	check(exponent == ref_exponent, name, "block exponent differs from reference");
+
+	int mismatches = 0;
+	for(int k = 0; k < FFT_DATALEN; k++) {
+		if(q15_lo(packed[k]) != ref[k].re || q15_hi(packed[k]) != ref[k].im) {
+			mismatches++;
+		}
+	}
+	check(mismatches == 0, name, "transform is not bit-exact");
+
+	// the fused window must give the same result as the windowed copy
+	static uint32_t fused[FFT_DATALEN];
+	uint32_t bits = fft_q15_load_windowed(input, fused);
+	int fused_exponent = fft_q15_transform_loaded(fused, bits);
+
+	mismatches = 0;
+	for(int k = 0; k < FFT_DATALEN; k++) {
+		if(fused[k] != packed[k]) {
+			mismatches++;
+		}
+	}
+	check(fused_exponent == exponent && mismatches == 0, name,
+	      "fft_q15_load_windowed() differs from the windowed copy");
+
+	fft_q15_complex_to_absolute(packed, exponent, absval);
+
+	// accuracy: compare against a double precision DFT of the windowed input
+	double err = 0, peak = 0, err_energy = 0, energy = 0;
+	for(int k = 0; k < FFT_DATALEN; k++) {
+		double re = 0, im = 0;
+		for(int n = 0; n < FFT_BLOCK_LEN; n++) {
+			re += windowed[n] * cos(2 * M_PI * k * n / FFT_BLOCK_LEN);
+			im -= windowed[n] * sin(2 * M_PI * k * n / FFT_BLOCK_LEN);
+		}
+
+		double mag = sqrt(re*re + im*im);
+		double e = hypot(re - ldexp(q15_lo(packed[k]), exponent),
+				im - ldexp(q15_hi(packed[k]), exponent));
+
+		if(mag > peak) { peak = mag; }
+		if(e > err) { err = e; }
+
+		energy += mag * mag;
+		err_energy += e * e;
+
+		uint32_t isq = (uint32_t)sqrt((double)q15_smuad(packed[k], packed[k]));
+		uint32_t scaled = exponent >= 0 ? isq << exponent : isq >> -exponent;
+		check(absval[k] == scaled, name, "integer square root differs");
+	}
+
+	// block floating point keeps the error relative to the signal small
+	double snr = (err_energy > 0) ? 10 * log10(energy / err_energy) : INFINITY;
+	check(peak == 0 ? err == 0 : snr > 50, name, "error against DFT too large");
+
+	// details only for failed cases, the rest goes into the summary
+	if(failures != failures_before) {
+		printf("%-12s exponent %3d  SNR %6.1f dB  max. error %.2e of peak\n", name,
+				exponent, snr, peak > 0 ? err / peak : 0);
+	}
+
+	num_cases++;
+	if(peak > 0) {
+		if(snr < worst_snr) { worst_snr = snr; }
+		if(err / peak > worst_error) { worst_error = err / peak; }
+	}
+}
+
+int main(void)
+{
+	static int16_t input[FFT_BLOCK_LEN];
+
+	for(int i = 0; i < FFT_BLOCK_LEN; i++) { input[i] = 0; }
+	run_case("silence", input);
+
+	for(int i = 0; i < FFT_BLOCK_LEN; i++) {
+		input[i] = 32767 * sin(2 * M_PI * 17.3 * i / FFT_BLOCK_LEN);
+	}
+	run_case("full scale", input);
+
+	for(int i = 0; i < FFT_BLOCK_LEN; i++) {
+		input[i] = 64 * sin(2 * M_PI * 5 * i / FFT_BLOCK_LEN);
+	}
+	run_case("quiet", input);
+
+	for(int i = 0; i < FFT_BLOCK_LEN; i++) {
+		input[i] = (i & 1) ? -32768 : 32767;
+	}
+	run_case("nyquist", input);
+
+	srand(1);
+	for(int c = 0; c < 100; c++) {
+		int amplitude = 1 << (c % 16);
+		for(int i = 0; i < FFT_BLOCK_LEN; i++) {
+			input[i] = (rand() % (2*amplitude)) - amplitude;
+		}
+		run_case("noise", input);
+	}
+
+	for(int i = 0; i < FFT_BLOCK_LEN; i++) {
+		input[i] = 2048 << 3;
+	}
+	run_case("dc", input);
+
+	printf("%d cases, worst SNR %.1f dB, max. error %.2e of peak\n", num_cases,
+			worst_snr, worst_error);
+
+	if(failures) {
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
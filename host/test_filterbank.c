@@ -0,0 +1,177 @@
+/*
+ * Host test for the filterbank: rectangular bands must give the same results
+ * as fft_get_energy_in_band(), also for other sample rates, generated banks
+ * must cover the range without gaps. Built for the float and the fixed-point
+ * (FFT_FIXED_POINT, Q16 weights) representation.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "config.h"
+#include "fft/fft.h"
+#include "fft/filterbank.h"
+
+#ifdef FFT_FIXED_POINT
+// magnitudes as from fft_q15_complex_to_absolute(), the results are truncated
+// once per segment
+#define TEST_SCALE 65536.0
+#define TEST_TOLERANCE 8.0
+#else
+#define TEST_SCALE 1.0
+#define TEST_TOLERANCE 0.0
+#endif
+
+static int failures = 0;
+
+// random magnitude in [0, TEST_SCALE], with a float copy for the references
+static void fill_random(filterbank_value *fft, fft_value_type *ref_fft)
+{
+	for(int i = 0; i < FFT_DATALEN; i++) {
+		fft[i] = (filterbank_value)((double)rand() / RAND_MAX * TEST_SCALE);
+		ref_fft[i] = fft[i];
+	}
+}
+
+static int close_to(filterbank_value value, double ref)
+{
+	return fabs(value - ref) <= 1e-5 * ref + TEST_TOLERANCE;
+}
+
+static void check(int cond, const char *name, const char *what)
+{
+	if(!cond) {
+		printf("FAIL %s: %s\n", name, what);
+		failures++;
+	}
+}
+
+static void check_sorted(const struct filterbank *fb, const char *name)
+{
+	for(uint32_t i = 1; i < fb->num_segments; i++) {
+		check(fb->segments[i-1].first_bin <= fb->segments[i].first_bin, name,
+				"segments not sorted by bin");
+	}
+}
+
+static void test_rect(void)
+{
+	static const struct filterbank_band bands[] = {
+		{   0,   400, FILTERBANK_RECT, 0, 1.0f},
+		{ 400,  2450, FILTERBANK_RECT, 1, 1.0f},
+		{2550,  4000, FILTERBANK_RECT, 1, 1.0f},
+		{4000,  4935, FILTERBANK_RECT, 2, 1.0f},
+		{5065,  7420, FILTERBANK_RECT, 2, 1.0f},
+		{7580,  9900, FILTERBANK_RECT, 2, 0.5f},
+		{ 300,  5000, FILTERBANK_RECT, 3, 1.0f},
+	};
+
+	static struct filterbank fb;
+	static filterbank_value fft[FFT_DATALEN];
+	static fft_value_type ref_fft[FFT_DATALEN];
+	filterbank_value energy[4];
+	fft_value_type ref[4];
+
+	check(filterbank_init(&fb, bands, sizeof(bands) / sizeof(bands[0])) == 0, "rect", "init failed");
+	check(fb.num_outputs == 4, "rect", "wrong number of outputs");
+	check_sorted(&fb, "rect");
+
+	fill_random(fft, ref_fft);
+
+	filterbank_apply(&fb, fft, energy);
+
+	ref[0] = fft_get_energy_in_band(ref_fft, 0, 400);
+	ref[1] = fft_get_energy_in_band(ref_fft, 400, 2450) + fft_get_energy_in_band(ref_fft, 2550, 4000);
+	ref[2] = fft_get_energy_in_band(ref_fft, 4000, 4935) + fft_get_energy_in_band(ref_fft, 5065, 7420)
+		+ 0.5f * fft_get_energy_in_band(ref_fft, 7580, 9900);
+	ref[3] = fft_get_energy_in_band(ref_fft, 300, 5000);
+
+	for(int i = 0; i < 4; i++) {
+		check(close_to(energy[i], ref[i]), "rect", "differs from fft_get_energy_in_band()");
+	}
+}
+
+// a band of the FFT of a decimated signal covers proportionally more bins
+static void test_rate(uint32_t sample_rate)
+{
+	static const struct filterbank_band bands[] = {
+		{   0,   400, FILTERBANK_RECT, 0, 1.0f},
+	};
+
+	static struct filterbank fb;
+	static filterbank_value fft[FFT_DATALEN];
+	static fft_value_type ref_fft[FFT_DATALEN];
+	filterbank_value energy[1];
+	double ref = 0;
+
+	check(filterbank_init_rate(&fb, bands, 1, sample_rate) == 0, "rate", "init failed");
+
+	fill_random(fft, ref_fft);
+
+	filterbank_apply(&fb, fft, energy);
+
+	for(uint32_t i = 0; i < 400 * FFT_BLOCK_LEN / sample_rate; i++) {
+		ref += ref_fft[i];
+	}
+
+	check(close_to(energy[0], ref), "rate", "wrong bins for the sample rate");
+}
+
+static void test_spaced(const char *name, enum filterbank_scale scale, uint32_t num_bands)
+{
+	static struct filterbank fb;
+	static filterbank_value fft[FFT_DATALEN];
+	filterbank_value energy[FILTERBANK_MAX_OUTPUTS];
+
+	check(filterbank_init_spaced(&fb, num_bands, 50, 10000, scale) == 0, name, "init failed");
+	check(fb.num_outputs == num_bands, name, "wrong number of outputs");
+	check_sorted(&fb, name);
+
+	for(int i = 0; i < FFT_DATALEN; i++) {
+		fft[i] = TEST_SCALE;
+	}
+
+	filterbank_apply(&fb, fft, energy);
+
+	for(uint32_t i = 0; i < num_bands; i++) {
+		check(energy[i] > 0, name, "empty band");
+	}
+
+	// a single bin must show up in the band(s) around it only
+	for(int i = 0; i < FFT_DATALEN; i++) {
+		fft[i] = 0;
+	}
+	fft[32] = TEST_SCALE;
+	filterbank_apply(&fb, fft, energy);
+
+	int nonzero = 0;
+	for(uint32_t i = 0; i < num_bands; i++) {
+		nonzero += energy[i] > 0;
+	}
+	check(nonzero >= 1 && nonzero <= 2, name, "bin not in one or two bands");
+
+	printf("%-8s %2u bands, %2u segments, %3u weights\n", name, (unsigned)num_bands,
+			(unsigned)fb.num_segments, (unsigned)fb.num_weights);
+}
+
+int main(void)
+{
+	srand(1);
+
+	test_rect();
+	test_rate(SAMPLE_RATE);
+	test_rate(SAMPLE_RATE / 8);
+	test_spaced("linear", FILTERBANK_LINEAR, 16);
+	test_spaced("log", FILTERBANK_LOG, 24);
+	test_spaced("mel", FILTERBANK_MEL, 32);
+
+	if(failures) {
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
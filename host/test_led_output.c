@@ -0,0 +1,220 @@
+/*
+ * Host test for the LED frame output: the fade between the submitted frames
+ * with a simulated clock, continuity when a frame is submitted during a fade,
+ * the limit of the fade time and the wrap-around of the clock. Also the
+ * scrolling history against shifted arrays.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "led_output.h"
+#include "ws2801.h"
+
+static int failures = 0;
+
+static void check(int cond, const char *what)
+{
+	if(!cond) {
+		printf("FAIL %s\n", what);
+		failures++;
+	}
+}
+
+static uint32_t now;
+
+static uint32_t fake_clock(void)
+{
+	return now;
+}
+
+static uint8_t sent[3 * WS2801_NUM_MODULES];
+static uint32_t frames_sent;
+
+enum ws2801_send_status ws2801_send_update(void)
+{
+	const uint8_t *message = ws2801_get_message();
+
+	for(uint32_t i = 0; i < 3 * WS2801_NUM_MODULES; i++) {
+		sent[i] = message[i];
+	}
+
+	frames_sent++;
+
+	return WS2801_SENT;
+}
+
+// red of module 0 (wire format is RBG) after rendering at the given time
+static uint8_t render_red(uint32_t t)
+{
+	now = t;
+	led_output_render();
+
+	return sent[0];
+}
+
+static void fill(struct led_frame *frame, float v)
+{
+	for(uint8_t i = 0; i < WS2801_NUM_MODULES; i++) {
+		led_frame_set_colour(frame, i, v, v, v);
+	}
+}
+
+static void test_fade(uint32_t start)
+{
+	static struct led_frame frame;
+	int ok;
+
+	now = start;
+	led_output_init(fake_clock);
+
+	check(render_red(start) == 0, "black after init");
+
+	// the first frame is faded in over the time since the initialisation
+	now = start + 1000;
+	fill(&frame, 1.0f);
+	led_output_submit(&frame);
+
+	check(render_red(start + 1000) == 0, "fade starts at the shown frame");
+	// linear 0.5, squared by the gamma correction
+	check(render_red(start + 1500) == 63, "half way");
+	check(render_red(start + 2000) == 255, "fade complete");
+	check(render_red(start + 9000) == 255, "frame held");
+
+	// all modules and channels
+	ok = 1;
+	for(uint32_t i = 0; i < 3 * WS2801_NUM_MODULES; i++) {
+		ok &= sent[i] == 255;
+	}
+	check(ok, "all channels");
+
+	// the next fade takes the time between the submissions (8500), and is
+	// monotonic
+	now = start + 9500;
+	fill(&frame, 0.0f);
+	led_output_submit(&frame);
+
+	uint8_t last = 255;
+	ok = 1;
+	for(uint32_t t = start + 9500; t != start + 18000 + 10; t += 10) {
+		uint8_t v = render_red(t);
+		ok &= v <= last;
+		last = v;
+	}
+	check(ok, "monotonic fade");
+	check(last == 0, "fade over the submission interval");
+
+	// a frame submitted during a fade continues from the shown value
+	now = start + 18500;
+	fill(&frame, 1.0f);
+	led_output_submit(&frame);
+	now = start + 19000;
+	led_output_submit(&frame);
+
+	uint8_t before = render_red(start + 19250);
+	now = start + 19250;
+	fill(&frame, 0.5f);
+	led_output_submit(&frame);
+	check(before > 63 && before < 255, "during the fade");
+	check(render_red(start + 19250) == before, "no jump on submission");
+	check(render_red(start + 19500) == 63, "new target reached");
+}
+
+/*
+ * After a long pause of the analysis the next frame is reached within
+ * LED_OUTPUT_MAX_INTERVAL.
+ */
+static void test_pause(void)
+{
+	static struct led_frame frame;
+
+	now = 0;
+	led_output_init(fake_clock);
+
+	now = 10 * LED_OUTPUT_MAX_INTERVAL;
+	fill(&frame, 1.0f);
+	led_output_submit(&frame);
+
+	check(render_red(10 * LED_OUTPUT_MAX_INTERVAL + LED_OUTPUT_MAX_INTERVAL / 2) == 63,
+	      "fade limited after a pause");
+	check(render_red(11 * LED_OUTPUT_MAX_INTERVAL) == 255, "frame reached after a pause");
+}
+
+static void test_clamp(void)
+{
+	static struct led_frame frame;
+
+	led_frame_set_colour(&frame, 0, 2.0f, -1.0f, 0.25f);
+
+	check(frame.r[0] == LED_OUTPUT_MAX, "clamped to full scale");
+	check(frame.g[0] == 0, "clamped to zero");
+	check(frame.b[0] == (LED_OUTPUT_MAX + 2) / 4, "in range");
+}
+
+/*
+ * The history behaves like an array which is shifted by n on every scroll,
+ * also across the wrap-around of the ring.
+ */
+static void test_history(uint32_t n)
+{
+	static struct led_history history;
+	static struct led_frame frame;
+	static struct led_frame reference;
+	int ok = 1;
+
+	led_history_reset(&history);
+	fill(&reference, 0.0f);
+
+	for(uint32_t step = 0; step < 3 * WS2801_NUM_MODULES; step++) {
+		float v = (step % 7) / 6.0f;
+
+		led_history_scroll(&history, n);
+		for(uint32_t i = WS2801_NUM_MODULES - 1; i >= n; i--) {
+			reference.r[i] = reference.r[i - n];
+			reference.g[i] = reference.g[i - n];
+			reference.b[i] = reference.b[i - n];
+		}
+
+		// only some of the first n modules are updated, the others keep their
+		// colour
+		led_history_set_colour(&history, 0, v, 1.0f - v, 0.5f);
+		led_frame_set_colour(&reference, 0, v, 1.0f - v, 0.5f);
+
+		if(n > 1 && step % 3 == 0) {
+			led_history_set_colour(&history, 1, 0.5f, v, 1.0f - v);
+			led_frame_set_colour(&reference, 1, 0.5f, v, 1.0f - v);
+		}
+
+		led_history_render(&history, &frame);
+
+		for(uint32_t i = 0; i < WS2801_NUM_MODULES; i++) {
+			ok &= frame.r[i] == reference.r[i];
+			ok &= frame.g[i] == reference.g[i];
+			ok &= frame.b[i] == reference.b[i];
+		}
+	}
+
+	check(ok, "history scrolls like a shifted array");
+}
+
+int main(void)
+{
+	// exact values (see test_ws2801_message.c for the dithering)
+	ws2801_set_dithering(false);
+
+	test_fade(0);
+	// the clock wraps around during the test
+	test_fade(0xFFFFFFFF - 5000);
+	test_pause();
+	test_clamp();
+	test_history(1);
+	test_history(2);
+
+	if(failures) {
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
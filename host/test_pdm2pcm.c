@@ -0,0 +1,248 @@
+/*
+ * Host test for the PDM decoder: tones are modulated by a second order
+ * sigma-delta modulator (like the one in a PDM microphone) and decoded. The
+ * output is checked for gain, noise and distortion, and for the rejection of
+ * a tone above the output Nyquist frequency.
+ *
+ * Recorded MP45DT02 captures (raw I2S DMA words, see audio_file.h) can be
+ * given as arguments. They are replayed through the file source, which decodes
+ * them like the firmware, and checked for level, DC and clipping. No capture
+ * is part of the tree; the Makefile passes PDM_CAPTURES.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "config.h"
+#include "pdm2pcm.h"
+#include "audio_file.h"
+
+#define PDM_RATE         3072000.0
+#define OVERSAMPLING     64
+#define OUT_RATE         (PDM_RATE / OVERSAMPLING)
+
+#define PDM_WORDS        (48000 * OVERSAMPLING / 32 / 10) // 100 ms of output
+#define MAX_OUT          (PDM_WORDS * 32 / OVERSAMPLING + 1)
+#define SETTLE           64 // output samples
+
+static int failures = 0;
+
+static uint32_t pdm_data[PDM_WORDS];
+static int32_t pcm_data[MAX_OUT];
+static fft_sample sample_data[MAX_OUT];
+
+static void check(int cond, const char *name, const char *what)
+{
+	if(!cond) {
+		printf("FAIL %s: %s\n", name, what);
+		failures++;
+	}
+}
+
+/*
+ * Fill pdm_data with the modulated tone. The bits are packed like the I2S DMA
+ * does it: 16 bits MSB first per transfer, the first transfer in the lower
+ * half of the word.
+ */
+static void modulate(double freq, double amplitude)
+{
+	double i1 = 0, i2 = 0, y = 0;
+
+	for(int w = 0; w < PDM_WORDS; w++) {
+		uint32_t word = 0;
+
+		for(int b = 0; b < 32; b++) {
+			double x = amplitude * sin(2 * M_PI * freq * (w * 32 + b) / PDM_RATE);
+
+			i1 += x - y;
+			i2 += i1 - y;
+			y = (i2 >= 0) ? 1 : -1;
+
+			if(y > 0) {
+				word |= 1u << (b < 16 ? 15 - b : 47 - b);
+			}
+		}
+
+		pdm_data[w] = word;
+	}
+}
+
+/*
+ * Decode pdm_data in blocks of varying length (to test the state handling)
+ * and fit a sine of the given frequency to the output. Returns the
+ * amplitude relative to full scale, *residual is set to the RMS of what is
+ * left, also relative to full scale.
+ */
+static double decode_and_fit(double freq, double *residual)
+{
+	struct pdm2pcm_ctx ctx;
+	size_t nout = 0;
+	double sum_c = 0, sum_s = 0, a_c, a_s, err = 0;
+	int n;
+
+	pdm2pcm_init(&ctx, OVERSAMPLING);
+
+	for(size_t w = 0, len = 1; w < PDM_WORDS; w += len, len = len % 37 + 1) {
+		if(w + len > PDM_WORDS) {
+			len = PDM_WORDS - w;
+		}
+		nout += pdm2pcm_decode(&ctx, &pdm_data[w], len, &pcm_data[nout]);
+	}
+
+	// the filter delay is irrelevant for the fit
+	n = nout - SETTLE;
+	for(int i = 0; i < n; i++) {
+		double phi = 2 * M_PI * freq * i / OUT_RATE;
+		double x = (double)pcm_data[SETTLE + i] / PDM2PCM_FULL_SCALE;
+
+		sum_c += x * cos(phi);
+		sum_s += x * sin(phi);
+	}
+
+	a_c = 2 * sum_c / n;
+	a_s = 2 * sum_s / n;
+
+	for(int i = 0; i < n; i++) {
+		double phi = 2 * M_PI * freq * i / OUT_RATE;
+		double x = (double)pcm_data[SETTLE + i] / PDM2PCM_FULL_SCALE;
+		double e = x - a_c * cos(phi) - a_s * sin(phi);
+
+		err += e * e;
+	}
+
+	*residual = sqrt(err / n);
+
+	return hypot(a_c, a_s);
+}
+
+/*
+ * The decoder for the FFT sample format must give the same samples, only
+ * scaled (and saturated in Q15).
+ */
+static void check_samples(void)
+{
+	struct pdm2pcm_ctx ctx;
+	size_t n;
+	double err = 0;
+
+	pdm2pcm_init(&ctx, OVERSAMPLING);
+	n = pdm2pcm_decode(&ctx, pdm_data, PDM_WORDS, pcm_data);
+
+	pdm2pcm_init(&ctx, OVERSAMPLING);
+	check(pdm2pcm_decode_samples(&ctx, pdm_data, PDM_WORDS, sample_data) == n,
+			"samples", "number of samples");
+
+	for(size_t i = 0; i < n; i++) {
+#ifdef FFT_FIXED_POINT
+		double e = fabs(sample_data[i] / 32768.0 - (double)pcm_data[i] / PDM2PCM_FULL_SCALE);
+#else
+		double e = fabs(sample_data[i] - (double)pcm_data[i] / PDM2PCM_FULL_SCALE);
+#endif
+		if(e > err) { err = e; }
+	}
+
+	check(err <= 1.0 / 65536, "samples", "pdm2pcm_decode_samples() differs");
+}
+
+static double sample_value(fft_sample s)
+{
+#ifdef FFT_FIXED_POINT
+	return s / 32768.0;
+#else
+	return s;
+#endif
+}
+
+/*
+ * A real microphone signal must decode to a plausible level: not silent, not
+ * clipping, and centered (the decoder keeps the small DC offset of the
+ * microphone, which must stay well below full scale).
+ */
+static void check_capture(const char *path)
+{
+	const struct audio_source *src = &audio_source_file;
+	const struct audio_block *block;
+	uint32_t nblocks = 0, clipped = 0;
+	double sum = 0, sum_sq = 0, peak = 0;
+
+	check(audio_file_open(path, AUDIO_FILE_PDM) == 0, path, "cannot open capture");
+	src->init();
+	src->start();
+
+	while((block = src->get_block()) != NULL) {
+		for(uint32_t i = 0; i < AUDIO_BLOCK_LEN; i++) {
+			double v = sample_value(block->samples[i]);
+
+			sum += v;
+			sum_sq += v * v;
+			if(fabs(v) > peak) { peak = fabs(v); }
+			if(fabs(v) >= 0.999) { clipped++; }
+		}
+		src->release_block();
+		nblocks++;
+	}
+
+	src->stop();
+	audio_file_close();
+
+	check(nblocks > 0, path, "no complete block");
+	if(nblocks == 0) {
+		return;
+	}
+
+	double n = (double)nblocks * AUDIO_BLOCK_LEN;
+	double dc = sum / n;
+	double rms = sqrt(sum_sq / n - dc * dc);
+
+	printf("%s: %u blocks, RMS %.1f dBFS, peak %.1f dBFS, DC %.4f, %u clipped\n", path,
+			(unsigned)nblocks, 20 * log10(rms + 1e-12), 20 * log10(peak + 1e-12), dc,
+			(unsigned)clipped);
+
+	check(rms > 1e-5, path, "silent");
+	check(clipped <= n / 1000, path, "clipping");
+	check(fabs(dc) < 0.1, path, "DC offset");
+}
+
+int main(int argc, char **argv)
+{
+	struct pdm2pcm_ctx ctx;
+	double amplitude, residual, sinad, rejection;
+
+	check(pdm2pcm_init(&ctx, 48) == -1, "init", "ratio 48 accepted");
+	check(pdm2pcm_init(&ctx, 32) == -1, "init", "ratio 32 accepted");
+	check(pdm2pcm_init(&ctx, OVERSAMPLING) == 0, "init", "ratio 64 rejected");
+
+	// in-band tone
+	modulate(1000, 0.5);
+	amplitude = decode_and_fit(1000, &residual);
+	sinad = 20 * log10(amplitude / sqrt(2) / residual);
+	printf("1 kHz:  amplitude %.4f, SINAD %.1f dB\n", amplitude, sinad);
+	check(fabs(amplitude - 0.5) < 0.005, "1 kHz", "gain");
+	check(sinad > 54, "1 kHz", "SINAD");
+
+	// output count: one sample per OVERSAMPLING bits
+	check(pdm2pcm_decode(&ctx, pdm_data, PDM_WORDS, pcm_data) == PDM_WORDS * 32 / OVERSAMPLING,
+			"1 kHz", "number of samples");
+
+	check_samples();
+
+	// 40 kHz aliases to 8 kHz at the output rate of 48 kHz
+	modulate(40000, 0.5);
+	amplitude = decode_and_fit(8000, &residual);
+	rejection = 20 * log10(0.5 / (amplitude + 1e-12));
+	printf("40 kHz: alias rejection %.1f dB\n", rejection);
+	check(rejection > 70, "40 kHz", "alias rejection");
+
+	for(int i = 1; i < argc; i++) {
+		check_capture(argv[i]);
+	}
+
+	if(failures) {
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,271 @@
+/*
+ * Host test for the cooperative scheduler with a simulated clock: the steps
+ * advance the clock by their nominal time, idle main loop passes by one unit.
+ * Checks the order of the jobs, the deferral of long steps in favour of tasks
+ * with a higher priority, the measurements and the statistics.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sched.h"
+
+static int failures = 0;
+
+static void check(int cond, const char *what)
+{
+	if(!cond) {
+		printf("FAIL %s\n", what);
+		failures++;
+	}
+}
+
+static uint32_t now;
+
+static uint32_t fake_clock(void)
+{
+	return now;
+}
+
+/*
+ * Test tasks: every job has num_steps steps of step_time each. The log
+ * records the order of the steps.
+ */
+struct test_task {
+	struct sched_task task;
+
+	uint32_t num_steps;
+	uint32_t step_time;
+	uint32_t cur_step;
+	bool event; // for event-driven tasks
+
+	uint32_t worst_latency; // from the release to the completion
+	uint32_t release_time;
+};
+
+#define LOG_LEN 64
+static char step_log[LOG_LEN + 1];
+static uint32_t log_pos;
+
+static struct test_task tasks[3];
+
+static bool test_step(struct test_task *t, char id)
+{
+	if(t->cur_step == 0) {
+		t->release_time = t->task.abs_deadline - t->task.deadline;
+	}
+
+	if(log_pos < LOG_LEN) {
+		step_log[log_pos++] = id;
+		step_log[log_pos] = '\0';
+	}
+
+	now += t->step_time;
+
+	t->cur_step++;
+	if(t->cur_step == t->num_steps) {
+		t->cur_step = 0;
+		t->event = false;
+
+		if(now - t->release_time > t->worst_latency) {
+			t->worst_latency = now - t->release_time;
+		}
+		return false;
+	}
+
+	return true;
+}
+
+static bool step_a(void) { return test_step(&tasks[0], 'a'); }
+static bool step_b(void) { return test_step(&tasks[1], 'b'); }
+static bool step_c(void) { return test_step(&tasks[2], 'c'); }
+
+static bool ready_a(void) { return tasks[0].event; }
+
+static void setup_task(struct test_task *t, bool (*step)(void), bool (*ready)(void),
+		uint32_t period, uint32_t deadline, uint8_t priority,
+		uint32_t num_steps, uint32_t step_time)
+{
+	t->task.name = "test";
+	t->task.step = step;
+	t->task.ready = ready;
+	t->task.period = period;
+	t->task.deadline = deadline;
+	t->task.priority = priority;
+
+	t->num_steps = num_steps;
+	t->step_time = step_time;
+	t->cur_step = 0;
+	t->event = false;
+	t->worst_latency = 0;
+	t->release_time = 0;
+
+	sched_add(&t->task);
+}
+
+static void reset(uint32_t start)
+{
+	now = start;
+	log_pos = 0;
+	step_log[0] = '\0';
+	sched_init(fake_clock);
+}
+
+// run the main loop until the given time
+static void run_until(uint32_t end)
+{
+	while((int32_t)(now - end) < 0) {
+		if(!sched_run()) {
+			now++;
+		}
+	}
+}
+
+static bool log_equals(const char *expected)
+{
+	uint32_t i = 0;
+
+	while(expected[i] && step_log[i] == expected[i]) {
+		i++;
+	}
+
+	return expected[i] == step_log[i];
+}
+
+/*
+ * Released at the same time: the earlier deadline first, then the higher
+ * priority.
+ */
+static void test_order(void)
+{
+	reset(0);
+	setup_task(&tasks[0], step_a, NULL, 100, 100, 1, 1, 10);
+	setup_task(&tasks[1], step_b, NULL, 100, 50, 1, 1, 10);
+	setup_task(&tasks[2], step_c, NULL, 100, 100, 2, 1, 10);
+
+	run_until(150);
+
+	check(log_equals("bca"), "earliest deadline, then priority");
+	check(tasks[0].task.jobs == 1 && tasks[1].task.jobs == 1 && tasks[2].task.jobs == 1,
+	      "one job each");
+}
+
+/*
+ * Steps are measured per index and the job time is their sum.
+ */
+static void test_measurement(void)
+{
+	reset(0);
+	setup_task(&tasks[0], step_a, NULL, 1000, 1000, 1, 3, 7);
+
+	run_until(1100);
+
+	check(tasks[0].task.step_time[0] == 7 && tasks[0].task.step_time[2] == 7,
+	      "step times");
+	check(tasks[0].task.job_steps == 3, "steps per job");
+	check(sched_get_job_time(&tasks[0].task) == 21, "job time");
+
+	// a single outlier is forgotten slowly
+	tasks[0].step_time = 700;
+	run_until(2100);
+	tasks[0].step_time = 7;
+	run_until(2000 + 1000 * (1 << SCHED_TIME_DECAY_SHIFT) * 4);
+
+	check(tasks[0].task.step_time[0] < 70, "outlier decays");
+	check(tasks[0].task.step_time[0] >= 7, "decay keeps the current time");
+}
+
+/*
+ * A long job of a low priority task is split into steps. Its steps are
+ * deferred if they would make the high priority task miss its deadline, so the
+ * high priority task is always on time, while the long job still completes
+ * within its own (longer) deadline.
+ */
+static void test_deferral(uint32_t start)
+{
+	reset(start);
+	// e.g. the audio blocks: short, tight deadline
+	setup_task(&tasks[0], step_a, NULL, 1000, 100, 2, 1, 50);
+	// e.g. the analysis: 10 steps of 90, not aligned with the other task
+	setup_task(&tasks[1], step_b, NULL, 2300, 2300, 1, 10, 90);
+
+	run_until(start + 200000);
+
+	check(tasks[0].task.jobs >= 199 && tasks[1].task.jobs >= 85, "all jobs done");
+	check(tasks[0].task.misses == 0, "high priority task on time");
+	check(tasks[0].worst_latency <= 100, "high priority latency");
+	check(tasks[1].task.misses == 0, "low priority task on time");
+	check(tasks[1].task.deferrals > 0, "steps deferred");
+	check(tasks[1].task.blocking == 0, "no blocking steps");
+	check(tasks[0].task.overruns == 0 && tasks[1].task.overruns == 0, "no overruns");
+}
+
+/*
+ * A step which never fits in between is run anyway (and counted), so the low
+ * priority task does not starve.
+ */
+static void test_blocking(void)
+{
+	reset(0);
+	setup_task(&tasks[0], step_a, NULL, 1000, 100, 2, 1, 50);
+	setup_task(&tasks[1], step_b, NULL, 5000, 5000, 1, 2, 1200);
+
+	run_until(50000);
+
+	check(tasks[1].task.jobs >= 9, "long steps not starved");
+	check(tasks[1].task.blocking > 0, "blocking steps counted");
+	check(tasks[0].task.misses > 0, "high priority task delayed");
+}
+
+/*
+ * A job longer than the period loses releases.
+ */
+static void test_overrun(void)
+{
+	reset(0);
+	setup_task(&tasks[0], step_a, NULL, 100, 100, 1, 3, 50);
+
+	run_until(1000);
+
+	check(tasks[0].task.overruns > 0, "overruns counted");
+	check(tasks[0].task.misses > 0, "late jobs counted");
+}
+
+/*
+ * Event-driven tasks are released when ready() returns true, and only then.
+ */
+static void test_event(void)
+{
+	reset(0);
+	setup_task(&tasks[0], step_a, ready_a, 500, 100, 2, 2, 10);
+
+	run_until(1000);
+	check(tasks[0].task.jobs == 0, "no event, no job");
+
+	tasks[0].event = true;
+	run_until(2000);
+	check(tasks[0].task.jobs == 1, "one job per event");
+	check(tasks[0].task.misses == 0, "event deadline");
+	check(tasks[0].worst_latency == 20, "event latency");
+}
+
+int main(void)
+{
+	test_order();
+	test_measurement();
+	test_deferral(0);
+	// the clock wraps around during the test
+	test_deferral(0xFFFFFFFF - 100000);
+	test_blocking();
+	test_overrun();
+	test_event();
+
+	if(failures) {
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
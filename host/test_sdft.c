@@ -0,0 +1,96 @@
+/*
+ * Host test for the sliding DFT: after an arbitrary number of samples, the
+ * magnitudes must match the block FFT pipeline on the last FFT_BLOCK_LEN
+ * samples.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "config.h"
+#include "fft/fft.h"
+#include "fft/sdft.h"
+
+static int failures = 0;
+
+static void check(int cond, const char *name, const char *what)
+{
+	if(!cond) {
+		printf("FAIL %s: %s\n", name, what);
+		failures++;
+	}
+}
+
+static double next_sample(int n)
+{
+	return 0.5 * sin(2 * M_PI * 1234 * n / SAMPLE_RATE)
+		+ 0.2 * sin(2 * M_PI * 97 * n / SAMPLE_RATE)
+		+ 0.1 * ((double)rand() / RAND_MAX - 0.5);
+}
+
+static void run_case(const char *name, int num_samples)
+{
+	static struct sdft_ctx sdft;
+	static fft_sample block[FFT_BLOCK_LEN], windowed[FFT_BLOCK_LEN];
+	static fft_value_type re[FFT_BLOCK_LEN], im[FFT_BLOCK_LEN], ref[FFT_DATALEN];
+	static fft_value_type result[SDFT_NUM_BINS];
+
+	sdft_init(&sdft);
+
+	for(int i = 0; i < FFT_BLOCK_LEN; i++) {
+		block[i] = 0;
+	}
+
+	for(int n = 0; n < num_samples; n++) {
+		fft_value_type x = next_sample(n);
+
+		sdft_update(&sdft, x);
+
+		for(int i = 0; i < FFT_BLOCK_LEN - 1; i++) {
+			block[i] = block[i+1];
+		}
+		block[FFT_BLOCK_LEN-1] = x;
+	}
+
+	fft_copy_windowed(block, windowed);
+	fft_transform_real(windowed, re, im);
+	fft_complex_to_absolute(re, im, ref);
+
+	sdft_get_absolute(&sdft, result);
+
+	double peak = 0, err = 0;
+	for(int k = 0; k < SDFT_NUM_BINS; k++) {
+		if(ref[k] > peak) { peak = ref[k]; }
+		if(fabs(ref[k] - result[k]) > err) { err = fabs(ref[k] - result[k]); }
+	}
+
+	check(err < 1e-4 * peak, name, "magnitudes differ from the block FFT");
+
+	double band = sdft_get_energy_in_band(&sdft, 400, 2450);
+	double ref_band = fft_get_energy_in_band(ref, 400, 2450);
+	check(fabs(band - ref_band) < 1e-4 * ref_band, name, "band energy differs from the block FFT");
+
+	printf("%-12s %8d samples  max. error %.2e of peak\n", name, num_samples, err / peak);
+}
+
+int main(void)
+{
+	srand(1);
+
+	run_case("partial", FFT_BLOCK_LEN / 3);
+	run_case("one block", FFT_BLOCK_LEN);
+	run_case("unaligned", 7 * FFT_BLOCK_LEN + 77);
+
+	// long runs must not drift thanks to the re-normalisation
+	run_case("long", 1000 * FFT_BLOCK_LEN + 5);
+
+	if(failures) {
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
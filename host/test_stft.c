@@ -0,0 +1,57 @@
+/*
+ * Host test for the STFT history buffer: after every hop, the block must
+ * contain the latest FFT_BLOCK_LEN samples in order.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "fft/stft.h"
+
+int main(void)
+{
+	static struct stft_ctx stft;
+	int failures = 0;
+	int blocks = 0;
+
+	stft_init(&stft);
+
+	for(int n = 0; n < 10 * FFT_BLOCK_LEN; n++) {
+		stft_push(&stft, n + 1);
+
+		if(stft_hop_ready(&stft) != ((n + 1) % STFT_HOP_SIZE == 0)) {
+			printf("FAIL hop not detected after sample %d\n", n);
+			failures++;
+		}
+
+		if(!stft_hop_ready(&stft)) {
+			continue;
+		}
+
+		fft_sample *block = stft_get_block(&stft);
+		blocks++;
+
+		for(int i = 0; i < FFT_BLOCK_LEN; i++) {
+			// samples before the start are zero
+			int expected = n + 1 - (FFT_BLOCK_LEN - 1 - i);
+			if(expected < 0) {
+				expected = 0;
+			}
+
+			if(block[i] != expected) {
+				printf("FAIL block %d, index %d: %d != %d\n", blocks, i, (int)block[i], expected);
+				failures++;
+				break;
+			}
+		}
+	}
+
+	if(failures) {
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("all checks passed (%d blocks)\n", blocks);
+	return 0;
+}
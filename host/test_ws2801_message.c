@@ -0,0 +1,215 @@
+/*
+ * Host test for the double-buffered WS2801 message: the hand-over between
+ * the application and the transfer (which is done by the DMA interrupt in the
+ * firmware), dropped frames, the wire format, the frame functions and the
+ * dithering.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "ws2801.h"
+
+#include "lut.h"
+
+static int failures = 0;
+
+static void check(int cond, const char *what)
+{
+	if(!cond) {
+		printf("FAIL %s\n", what);
+		failures++;
+	}
+}
+
+static void fill(float v)
+{
+	for(uint8_t i = 0; i < WS2801_NUM_MODULES; i++) {
+		ws2801_set_colour(i, v, v, v);
+	}
+}
+
+static int all_equal(const uint8_t *message, uint8_t v)
+{
+	int ok = 1;
+
+	for(uint32_t i = 0; i < 3 * WS2801_NUM_MODULES; i++) {
+		ok &= message[i] == v;
+	}
+
+	return ok;
+}
+
+static void test_handover(void)
+{
+	const uint8_t *sending;
+
+	check(ws2801_take_message() == NULL, "nothing queued at the start");
+
+	// frame 1 is queued and taken by the transfer
+	check(ws2801_begin_update(), "back buffer free");
+	fill(1.0f);
+	ws2801_queue_message();
+
+	sending = ws2801_take_message();
+	check(sending != NULL && all_equal(sending, 255), "first frame taken");
+	check(sending != ws2801_get_message(), "buffers swapped");
+	check(all_equal(ws2801_get_message(), 255), "back buffer starts with the sent frame");
+	check(ws2801_take_message() == NULL, "taken only once");
+
+	// frame 2 is written while frame 1 is being sent
+	check(ws2801_begin_update(), "back buffer free during a transfer");
+	ws2801_set_colour(0, 0, 0, 0);
+	ws2801_queue_message();
+	check(all_equal(sending, 255), "sent frame not modified");
+
+	// frame 3 comes before the transfer of frame 1 is done: dropped
+	uint32_t dropped = ws2801_get_dropped();
+	check(!ws2801_begin_update(), "back buffer queued");
+	check(ws2801_get_dropped() == dropped + 1, "dropped frame counted");
+
+	// the transfer of frame 2 starts
+	sending = ws2801_take_message();
+	check(sending != NULL, "second frame taken");
+	check(sending[0] == 0 && sending[1] == 0 && sending[2] == 0, "module 0 updated");
+	check(sending[3] == 255, "other modules keep their colour");
+	check(ws2801_begin_update(), "back buffer free again");
+}
+
+static void test_wire_format(void)
+{
+	check(ws2801_begin_update(), "back buffer free");
+
+	ws2801_set_colour(1, 1.0f, 0.5f, 0.0f);
+
+	// gamma 2, RBG order
+	const uint8_t *message = ws2801_get_message();
+	check(message[3] == 255 && message[4] == 0 && message[5] == 63, "wire format");
+}
+
+static uint16_t frame_r[WS2801_NUM_MODULES];
+static uint16_t frame_g[WS2801_NUM_MODULES];
+static uint16_t frame_b[WS2801_NUM_MODULES];
+
+/*
+ * The frame functions give the same result as ws2801_set_colour() for all
+ * input formats.
+ */
+static void test_frame_formats(void)
+{
+	static int16_t q_r[WS2801_NUM_MODULES], q_g[WS2801_NUM_MODULES], q_b[WS2801_NUM_MODULES];
+	static float f_r[WS2801_NUM_MODULES], f_g[WS2801_NUM_MODULES], f_b[WS2801_NUM_MODULES];
+	static uint8_t expected[3 * WS2801_NUM_MODULES];
+	const uint8_t *message = ws2801_get_message();
+	int ok_u16 = 1, ok_q15 = 1, ok_float = 1;
+
+	ws2801_set_dithering(false);
+
+	for(uint32_t i = 0; i < WS2801_NUM_MODULES; i++) {
+		float v = (float)i / (WS2801_NUM_MODULES - 1);
+
+		f_r[i] = v;
+		f_g[i] = 1.0f - v;
+		f_b[i] = v * v;
+		q_r[i] = f_r[i] * 32767 + 0.5f;
+		q_g[i] = f_g[i] * 32767 + 0.5f;
+		q_b[i] = f_b[i] * 32767 + 0.5f;
+		frame_r[i] = f_r[i] * 0xFFFF + 0.5f;
+		frame_g[i] = f_g[i] * 0xFFFF + 0.5f;
+		frame_b[i] = f_b[i] * 0xFFFF + 0.5f;
+
+		ws2801_set_colour(i, f_r[i], f_g[i], f_b[i]);
+	}
+
+	for(uint32_t i = 0; i < 3 * WS2801_NUM_MODULES; i++) {
+		expected[i] = message[i];
+	}
+
+	ws2801_set_frame(frame_r, frame_g, frame_b);
+	for(uint32_t i = 0; i < 3 * WS2801_NUM_MODULES; i++) {
+		ok_u16 &= message[i] == expected[i];
+	}
+
+	ws2801_set_frame_q15(q_r, q_g, q_b);
+	for(uint32_t i = 0; i < 3 * WS2801_NUM_MODULES; i++) {
+		// Q15 has one bit less, the result may be one step lower
+		ok_q15 &= message[i] == expected[i] || message[i] + 1 == expected[i];
+	}
+
+	ws2801_set_frame_float(f_r, f_g, f_b);
+	for(uint32_t i = 0; i < 3 * WS2801_NUM_MODULES; i++) {
+		ok_float &= message[i] == expected[i];
+	}
+
+	check(ok_u16, "16 bit frame");
+	check(ok_q15, "Q15 frame");
+	check(ok_float, "float frame");
+	check(expected[0] == 0 && expected[2] == 255, "full range");
+}
+
+/*
+ * With dithering, a level between two PWM steps is shown by alternating
+ * between them, with the right average. Without, it is truncated.
+ */
+static void test_dithering(float v)
+{
+	const uint8_t *message = ws2801_get_message();
+	float target = 255.0f * v * v;
+	// of the gamma table, which is indexed with the top LED_GAMMA_BITS
+	float table_error = 2 * 255.0f * v / (1 << LED_GAMMA_BITS);
+	uint32_t sum = 0;
+
+	for(uint32_t i = 0; i < WS2801_NUM_MODULES; i++) {
+		frame_r[i] = frame_g[i] = frame_b[i] = v * 0xFFFF + 0.5f;
+	}
+
+	ws2801_set_dithering(false);
+	ws2801_set_frame(frame_r, frame_g, frame_b);
+	check(message[0] == (uint8_t)(target - table_error) ||
+	      message[0] == (uint8_t)(target + table_error), "truncated without dithering");
+
+	ws2801_set_dithering(true);
+
+	// over 16 frames, every module has the same average
+	for(uint32_t f = 0; f < 16; f++) {
+		ws2801_set_frame(frame_r, frame_g, frame_b);
+
+		for(uint32_t i = 0; i < 3 * WS2801_NUM_MODULES; i++) {
+			sum += message[i];
+		}
+	}
+
+	float mean = (float)sum / (16 * 3 * WS2801_NUM_MODULES);
+	check(fabsf(mean - target) < 1.0f/16 + table_error, "dithered average");
+
+	// the modules do not switch all at once
+	ws2801_set_frame(frame_r, frame_g, frame_b);
+	int same = 1;
+	for(uint32_t i = 1; i < WS2801_NUM_MODULES; i++) {
+		same &= message[3 * i] == message[0];
+	}
+	check(!same || target == (uint8_t)target, "modules at different phases");
+
+	ws2801_set_dithering(false);
+}
+
+int main(void)
+{
+	test_handover();
+	test_wire_format();
+	test_frame_formats();
+	// below the first PWM step, between two steps and close to full scale
+	test_dithering(0.05f);
+	test_dithering(0.3f);
+	test_dithering(0.99f);
+
+	if(failures) {
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
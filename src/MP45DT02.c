@@ -61,8 +61,10 @@ void mp45dt02_init(uint32_t *buf0, uint32_t *buf1, uint32_t n)
 	// Setup DMA for I2S2:
 	// stream 3, channel 0, 16 transfers burst from memory, single transfers to peripheral
 	// double buffer mode, 32bit input, 16bit output, increase memory addresse, copy from periph to mem
+	// interrupt whenever a buffer is complete
 	DMA1_S3CR = DMA_SxCR_CHSEL_0 | DMA_SxCR_MBURST_SINGLE | DMA_SxCR_PBURST_SINGLE | DMA_SxCR_PL_HIGH
-		| DMA_SxCR_DBM | DMA_SxCR_MSIZE_32BIT | DMA_SxCR_PSIZE_16BIT | DMA_SxCR_MINC | DMA_SxCR_DIR_PERIPHERAL_TO_MEM;
+		| DMA_SxCR_DBM | DMA_SxCR_MSIZE_32BIT | DMA_SxCR_PSIZE_16BIT | DMA_SxCR_MINC | DMA_SxCR_DIR_PERIPHERAL_TO_MEM
+		| DMA_SxCR_TCIE;
 
 	DMA1_S3PAR = &SPI2_DR;
 	DMA1_S3M0AR = buf0;
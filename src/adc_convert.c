@@ -0,0 +1,86 @@
+#include "adc_convert.h"
+#include "constants.h"
+
+// the block mean is calculated by shifting
+#if AUDIO_BLOCK_LEN != (1 << STFT_HOP_EXPONENT) || STFT_HOP_EXPONENT > ADC_DC_FRAC_BITS
+#error "AUDIO_BLOCK_LEN must be a power of two up to 2^ADC_DC_FRAC_BITS"
+#endif
+
+// convert a DC-free ADC value to the FFT sample format
+#ifdef FFT_FIXED_POINT
+#define ADC_SAMPLE_SCALE (1 << (15 - ADC_BITS))
+#define ADC_TO_SAMPLE(x) ((fft_sample)((x) * ADC_SAMPLE_SCALE))
+#else
+#define ADC_SAMPLE_SCALE (1.0f / (1 << ADC_BITS))
+#define ADC_TO_SAMPLE(x) ((x) * ADC_SAMPLE_SCALE)
+#endif
+
+int adc_convert_init(struct adc_convert_ctx *ctx, float corner_freq)
+{
+	// corner frequency of the averaging with a factor of 2^-shift per block:
+	// block rate / (2 pi 2^shift)
+	float freq = (float)SAMPLE_RATE / AUDIO_BLOCK_LEN / (2 * PI);
+	uint32_t shift = 0;
+
+	if(!(corner_freq > 0)) {
+		return -1;
+	}
+
+	// nearest on a logarithmic scale
+	while(freq > corner_freq * 1.41421356f) {
+		freq /= 2;
+		shift++;
+	}
+
+	if(shift < 1 || shift > ADC_DC_MAX_SHIFT) {
+		return -1;
+	}
+
+	ctx->dc = (1 << (ADC_BITS - 1)) << ADC_DC_FRAC_BITS;
+	ctx->shift = shift;
+	ctx->blocks = 0;
+
+	return 0;
+}
+
+void adc_convert_block(struct adc_convert_ctx *ctx, const volatile uint16_t *raw,
+                       struct audio_block *block)
+{
+	uint32_t sum = 0;
+	int32_t dc, mean;
+	uint32_t shift;
+
+	if(ctx->blocks == 0) {
+		// no estimate yet: use the mean of this block
+		for(uint32_t i = 0; i < AUDIO_BLOCK_LEN; i++) {
+			sum += raw[i];
+		}
+
+		ctx->dc = sum << (ADC_DC_FRAC_BITS - STFT_HOP_EXPONENT);
+		sum = 0;
+	}
+
+	// the estimate is constant for the whole block, rounded to full LSB
+	dc = (ctx->dc + (1 << (ADC_DC_FRAC_BITS - 1))) >> ADC_DC_FRAC_BITS;
+
+	for(uint32_t i = 0; i < AUDIO_BLOCK_LEN; i++) {
+		uint16_t adcval = raw[i];
+
+		sum += adcval;
+		block->samples[i] = ADC_TO_SAMPLE((int32_t)adcval - dc);
+	}
+
+	block->mean = ((int32_t)sum - AUDIO_BLOCK_LEN * dc) * (ADC_SAMPLE_SCALE / (float)AUDIO_BLOCK_LEN);
+
+	// update the estimate for the next block. While starting up, this is the
+	// mean of all blocks so far (approximated by powers of two).
+	if(ctx->blocks < (1U << ctx->shift)) {
+		ctx->blocks++;
+		shift = 31 - __builtin_clz(ctx->blocks + 1);
+	} else {
+		shift = ctx->shift;
+	}
+
+	mean = sum << (ADC_DC_FRAC_BITS - STFT_HOP_EXPONENT);
+	ctx->dc += (mean - ctx->dc) >> shift;
+}
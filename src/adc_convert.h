@@ -0,0 +1,49 @@
+#ifndef ADC_CONVERT_H
+#define ADC_CONVERT_H
+
+#include <stdint.h>
+
+#include "config.h"
+#include "audio_source.h"
+
+// raw ADC values: 12 bit, unsigned
+#define ADC_BITS 12
+
+// the DC estimate is kept with this many fractional bits
+#define ADC_DC_FRAC_BITS 16
+
+// limits of the DC averaging (2^-shift per block)
+#define ADC_DC_MAX_SHIFT 16
+
+/*
+ * Conversion of raw ADC values to the FFT sample format, including the
+ * removal of the DC offset (the microphone signal is centered at about half
+ * the reference voltage).
+ *
+ * The DC offset is estimated once per block from the block mean by a
+ * first-order lowpass, whose output is subtracted from the next block. This
+ * is a highpass with the corner frequency given to adc_convert_init(). The
+ * first block initializes the estimate directly and the averaging time then
+ * grows to its final value, so there is no startup transient.
+ */
+struct adc_convert_ctx {
+	int32_t dc;       // DC estimate in LSB, ADC_DC_FRAC_BITS fractional bits
+	uint32_t shift;   // averaging factor 2^-shift per block
+	uint32_t blocks;  // blocks converted, saturates at 2^shift
+};
+
+/*
+ * Set up for a highpass corner frequency of about corner_freq Hz (rounded to
+ * the nearest power of two averaging factor). Returns 0 on success, -1 if the
+ * frequency cannot be realized at the block rate SAMPLE_RATE / AUDIO_BLOCK_LEN.
+ */
+int adc_convert_init(struct adc_convert_ctx *ctx, float corner_freq);
+
+/*
+ * Convert one block of AUDIO_BLOCK_LEN raw values to block->samples and set
+ * block->mean.
+ */
+void adc_convert_block(struct adc_convert_ctx *ctx, const volatile uint16_t *raw,
+                       struct audio_block *block);
+
+#endif // ADC_CONVERT_H
@@ -0,0 +1,212 @@
+/*
+ * Audio source: analog microphone (with amplifier) at PA4, sampled by ADC1 at
+ * SAMPLE_RATE (triggered by TIM3).
+ */
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/timer.h>
+#include <libopencm3/stm32/adc.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/cm3/nvic.h>
+
+#include <stddef.h>
+
+#include "audio_source.h"
+#include "adc_convert.h"
+#include "debug.h"
+
+// transfer the ADC conversions by DMA and convert them in blocks of
+// ADC_DMA_BLOCK_LEN samples (at most about 300 interrupts per second) instead
+// of interrupting after every conversion
+#define ADC_DMA
+
+// at least 128 samples, and whole audio blocks for larger hop sizes
+#if AUDIO_BLOCK_LEN > 128
+#define ADC_DMA_BLOCK_LEN AUDIO_BLOCK_LEN
+#else
+#define ADC_DMA_BLOCK_LEN 128
+#endif
+
+#ifdef ADC_DMA
+#define ADC_IRQ NVIC_DMA2_STREAM0_IRQ
+
+#if (ADC_DMA_BLOCK_LEN % AUDIO_BLOCK_LEN) != 0
+#error "ADC_DMA_BLOCK_LEN must be a multiple of AUDIO_BLOCK_LEN"
+#endif
+#else
+#define ADC_IRQ NVIC_ADC_IRQ
+#endif
+
+static struct audio_queue adc_queue;
+static struct adc_convert_ctx adc_convert;
+
+#ifdef ADC_DMA
+// written by DMA2 in circular mode: the first half is complete on the half
+// transfer event, the second half on the transfer complete event
+static volatile uint16_t adc_dma_buffer[2 * ADC_DMA_BLOCK_LEN];
+#endif
+
+static void adc_source_init(void)
+{
+	uint8_t channel = ADC_CHANNEL4;
+
+	audio_queue_init(&adc_queue);
+
+	// without a valid DC removal the samples are useless, so the ADC is not
+	// set up at all (the source then delivers no blocks)
+	if(adc_convert_init(&adc_convert, ADC_DC_CORNER_FREQ) != 0) {
+		debug_send_string("adc: ADC_DC_CORNER_FREQ cannot be realized at the block rate\r\n");
+		return;
+	}
+
+	rcc_periph_clock_enable(RCC_GPIOA);
+	rcc_periph_clock_enable(RCC_ADC1);
+	rcc_periph_clock_enable(RCC_TIM3);
+#ifdef ADC_DMA
+	// DMA2 transfers for ADC1
+	rcc_periph_clock_enable(RCC_DMA2);
+#endif
+
+	// analog input
+	gpio_mode_setup(GPIOA, GPIO_MODE_ANALOG, GPIO_PUPD_NONE, GPIO4);
+
+	adc_set_multi_mode(ADC_CCR_MULTI_INDEPENDENT);
+
+	adc_power_off(ADC1);
+
+	adc_disable_scan_mode(ADC1);
+	adc_set_single_conversion_mode(ADC1);
+	adc_set_sample_time_on_all_channels(ADC1, ADC_SMPR_SMP_144CYC);
+	adc_set_right_aligned(ADC1);
+	adc_set_regular_sequence(ADC1, 1, &channel);
+
+	adc_enable_external_trigger_regular(ADC1, ADC_CR2_EXTSEL_TIM3_TRGO, ADC_CR2_EXTEN_RISING_EDGE);
+
+#ifdef ADC_DMA
+	// DMA2 stream 0, channel 0: ADC1 data register to adc_dma_buffer, circular
+	dma_stream_reset(DMA2, DMA_STREAM0);
+	dma_channel_select(DMA2, DMA_STREAM0, DMA_SxCR_CHSEL_0);
+	dma_set_priority(DMA2, DMA_STREAM0, DMA_SxCR_PL_HIGH);
+	dma_set_peripheral_size(DMA2, DMA_STREAM0, DMA_SxCR_PSIZE_16BIT);
+	dma_set_memory_size(DMA2, DMA_STREAM0, DMA_SxCR_MSIZE_16BIT);
+	dma_enable_memory_increment_mode(DMA2, DMA_STREAM0);
+	dma_enable_circular_mode(DMA2, DMA_STREAM0);
+	dma_set_transfer_mode(DMA2, DMA_STREAM0, DMA_SxCR_DIR_PERIPHERAL_TO_MEM);
+	dma_set_peripheral_address(DMA2, DMA_STREAM0, (uint32_t)&ADC1_DR);
+	dma_set_memory_address(DMA2, DMA_STREAM0, (uint32_t)adc_dma_buffer);
+	dma_set_number_of_data(DMA2, DMA_STREAM0, 2 * ADC_DMA_BLOCK_LEN);
+	dma_enable_half_transfer_interrupt(DMA2, DMA_STREAM0);
+	dma_enable_transfer_complete_interrupt(DMA2, DMA_STREAM0);
+	dma_enable_stream(DMA2, DMA_STREAM0);
+
+	// keep issuing DMA requests after the first NDTR transfers (circular mode)
+	adc_enable_dma(ADC1);
+	adc_set_dma_continue(ADC1);
+#else
+	adc_enable_eoc_interrupt(ADC1);
+#endif
+
+	adc_power_on(ADC1);
+
+	// *** TIM3: conversion trigger ***
+	timer_reset(TIM3);
+	timer_set_mode(TIM3, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+
+	// prescaler
+	timer_set_prescaler(TIM3, 120); // count up by 1 every 1 us
+
+	// auto-reload value
+	timer_set_period(TIM3, 25); // 40 kHz tick rate
+
+	timer_set_master_mode(TIM3, TIM_CR2_MMS_UPDATE);
+}
+
+static void adc_source_start(void)
+{
+	nvic_enable_irq(ADC_IRQ);
+	timer_enable_counter(TIM3);
+}
+
+static void adc_source_stop(void)
+{
+	timer_disable_counter(TIM3);
+	nvic_disable_irq(ADC_IRQ);
+}
+
+static const struct audio_block* adc_source_get_block(void)
+{
+	return audio_queue_peek(&adc_queue);
+}
+
+static void adc_source_release_block(void)
+{
+	audio_queue_release(&adc_queue);
+}
+
+static uint32_t adc_source_get_dropped(void)
+{
+	return audio_queue_get_dropped(&adc_queue);
+}
+
+const struct audio_source audio_source_adc = {
+	.name = "adc",
+	.init = adc_source_init,
+	.start = adc_source_start,
+	.stop = adc_source_stop,
+	.get_block = adc_source_get_block,
+	.release_block = adc_source_release_block,
+	.get_dropped = adc_source_get_dropped,
+};
+
+#ifdef ADC_DMA
+void dma2_stream0_isr(void)
+{
+	const volatile uint16_t *dma_block = NULL;
+
+	if(dma_get_interrupt_flag(DMA2, DMA_STREAM0, DMA_HTIF)) {
+		dma_clear_interrupt_flags(DMA2, DMA_STREAM0, DMA_HTIF);
+		dma_block = adc_dma_buffer;
+	} else if(dma_get_interrupt_flag(DMA2, DMA_STREAM0, DMA_TCIF)) {
+		dma_clear_interrupt_flags(DMA2, DMA_STREAM0, DMA_TCIF);
+		dma_block = adc_dma_buffer + ADC_DMA_BLOCK_LEN;
+	}
+
+	if(!dma_block) {
+		return;
+	}
+
+	// the DMA is now filling the other half, so this one is stable for the
+	// next ADC_DMA_BLOCK_LEN sample periods
+	for(uint32_t b = 0; b < ADC_DMA_BLOCK_LEN; b += AUDIO_BLOCK_LEN) {
+		struct audio_block *block = audio_queue_begin_write(&adc_queue);
+
+		// if the main loop falls behind, the block is dropped (and counted)
+		if(block) {
+			adc_convert_block(&adc_convert, dma_block + b, block);
+			audio_queue_commit(&adc_queue);
+		}
+	}
+}
+#else
+void adc_isr(void)
+{
+	static uint16_t raw[AUDIO_BLOCK_LEN];
+	static uint32_t fill = 0;
+
+	if(adc_eoc(ADC1)) { //ADC1_SR & ADC_SR_EOC) {
+		raw[fill++] = adc_read_regular(ADC1);
+
+		// convert once per block like the DMA variant
+		if(fill == AUDIO_BLOCK_LEN) {
+			struct audio_block *block = audio_queue_begin_write(&adc_queue);
+
+			if(block) {
+				adc_convert_block(&adc_convert, raw, block);
+				audio_queue_commit(&adc_queue);
+			}
+			fill = 0;
+		}
+	}
+}
+#endif
@@ -0,0 +1,86 @@
+/*
+ * Audio source: on-board MP45DT02 MEMS microphone. The PDM bit stream is
+ * received by I2S2 and DMA1 into two alternating buffers, each of which is
+ * decoded into one block when it is complete.
+ */
+
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/cm3/nvic.h>
+
+#include "audio_source.h"
+#include "MP45DT02.h"
+#include "pdm2pcm.h"
+
+// PDM bits per sample: 3.072 MHz bit clock / 48 kHz (see mp45dt02_init())
+#define MIC_OVERSAMPLING 64
+
+#define MIC_BUFFER_WORDS (AUDIO_BLOCK_LEN * MIC_OVERSAMPLING / 32)
+
+static struct audio_queue mic_queue;
+static struct pdm2pcm_ctx mic_pdm;
+
+// the DMA switches between these buffers (double buffer mode)
+static uint32_t mic_buffers[2][MIC_BUFFER_WORDS];
+
+static void mic_source_init(void)
+{
+	audio_queue_init(&mic_queue);
+	pdm2pcm_init(&mic_pdm, MIC_OVERSAMPLING);
+
+	mp45dt02_init(mic_buffers[0], mic_buffers[1], MIC_BUFFER_WORDS);
+}
+
+static void mic_source_start(void)
+{
+	nvic_enable_irq(NVIC_DMA1_STREAM3_IRQ);
+	mp45dt02_start();
+}
+
+static void mic_source_stop(void)
+{
+	// the DMA keeps running, the buffers are just not decoded
+	nvic_disable_irq(NVIC_DMA1_STREAM3_IRQ);
+}
+
+static const struct audio_block* mic_source_get_block(void)
+{
+	return audio_queue_peek(&mic_queue);
+}
+
+static void mic_source_release_block(void)
+{
+	audio_queue_release(&mic_queue);
+}
+
+static uint32_t mic_source_get_dropped(void)
+{
+	return audio_queue_get_dropped(&mic_queue);
+}
+
+const struct audio_source audio_source_mp45dt02 = {
+	.name = "mp45dt02",
+	.init = mic_source_init,
+	.start = mic_source_start,
+	.stop = mic_source_stop,
+	.get_block = mic_source_get_block,
+	.release_block = mic_source_release_block,
+	.get_dropped = mic_source_get_dropped,
+};
+
+void dma1_stream3_isr(void)
+{
+	if(dma_get_interrupt_flag(DMA1, DMA_STREAM3, DMA_TCIF)) {
+		dma_clear_interrupt_flags(DMA1, DMA_STREAM3, DMA_TCIF);
+
+		// the DMA has switched to the other buffer, so this one is complete
+		const uint32_t *buf = mic_buffers[mp45dt02_dma_get_current_buffer() ? 0 : 1];
+		struct audio_block *block = audio_queue_begin_write(&mic_queue);
+
+		// if the main loop falls behind, the block is dropped (and counted)
+		if(block) {
+			pdm2pcm_decode_samples(&mic_pdm, buf, MIC_BUFFER_WORDS, block->samples);
+			audio_block_update_mean(block);
+			audio_queue_commit(&mic_queue);
+		}
+	}
+}
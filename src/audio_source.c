@@ -0,0 +1,76 @@
+#include <stddef.h>
+
+#include "audio_source.h"
+
+void audio_queue_init(struct audio_queue *queue)
+{
+	queue->widx = 0;
+	queue->ridx = 0;
+	queue->next_timestamp = 0;
+	queue->dropped = 0;
+}
+
+void audio_block_update_mean(struct audio_block *block)
+{
+	float sum = 0;
+
+	for(uint32_t i = 0; i < AUDIO_BLOCK_LEN; i++) {
+		sum += block->samples[i];
+	}
+
+	block->mean = sum * (1.0f / AUDIO_BLOCK_LEN);
+}
+
+struct audio_block* audio_queue_begin_write(struct audio_queue *queue)
+{
+	uint32_t widx = __atomic_load_n(&queue->widx, __ATOMIC_RELAXED);
+	uint32_t ridx = __atomic_load_n(&queue->ridx, __ATOMIC_ACQUIRE);
+	struct audio_block *block;
+
+	if(widx - ridx == AUDIO_QUEUE_BLOCKS) {
+		// the samples of the lost block still count
+		queue->next_timestamp += AUDIO_BLOCK_LEN;
+		__atomic_store_n(&queue->dropped, queue->dropped + 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+
+	block = &queue->blocks[widx & AUDIO_QUEUE_MASK];
+	block->timestamp = queue->next_timestamp;
+
+	return block;
+}
+
+void audio_queue_commit(struct audio_queue *queue)
+{
+	uint32_t widx = __atomic_load_n(&queue->widx, __ATOMIC_RELAXED);
+
+	queue->next_timestamp += AUDIO_BLOCK_LEN;
+
+	// the block must be visible before the new index
+	__atomic_store_n(&queue->widx, widx + 1, __ATOMIC_RELEASE);
+}
+
+const struct audio_block* audio_queue_peek(struct audio_queue *queue)
+{
+	uint32_t ridx = __atomic_load_n(&queue->ridx, __ATOMIC_RELAXED);
+	uint32_t widx = __atomic_load_n(&queue->widx, __ATOMIC_ACQUIRE);
+
+	if(widx == ridx) {
+		return NULL;
+	}
+
+	return &queue->blocks[ridx & AUDIO_QUEUE_MASK];
+}
+
+void audio_queue_release(struct audio_queue *queue)
+{
+	uint32_t ridx = __atomic_load_n(&queue->ridx, __ATOMIC_RELAXED);
+
+	// the block must be read before the producer may overwrite it
+	__atomic_store_n(&queue->ridx, ridx + 1, __ATOMIC_RELEASE);
+}
+
+uint32_t audio_queue_get_dropped(struct audio_queue *queue)
+{
+	return __atomic_load_n(&queue->dropped, __ATOMIC_RELAXED);
+}
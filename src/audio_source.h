@@ -0,0 +1,94 @@
+#ifndef AUDIO_SOURCE_H
+#define AUDIO_SOURCE_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+// samples per block, one STFT hop
+#define AUDIO_BLOCK_LEN    STFT_HOP_SIZE
+
+// blocks buffered between the source and the main loop
+#define AUDIO_QUEUE_BLOCKS 4
+#define AUDIO_QUEUE_MASK   (AUDIO_QUEUE_BLOCKS - 1)
+
+#if (AUDIO_QUEUE_BLOCKS & AUDIO_QUEUE_MASK) != 0
+#error "AUDIO_QUEUE_BLOCKS must be a power of two"
+#endif
+
+struct audio_block {
+	fft_sample samples[AUDIO_BLOCK_LEN]; // FFT sample format, full scale 1.0
+	uint32_t timestamp; // index of the first sample since the source was initialized
+	float mean; // mean of the samples (same scale), e.g. for removing the DC offset
+};
+
+/*
+ * An audio input. The source converts its data directly into the blocks of
+ * its queue, the consumer processes them in place:
+ *
+ *   const struct audio_block *block = source->get_block();
+ *   if(block) {
+ *     ... use block->samples ...
+ *     source->release_block();
+ *   }
+ *
+ * If the consumer falls behind, new blocks are dropped (and their samples
+ * still counted in the timestamps).
+ */
+struct audio_source {
+	const char *name;
+
+	void (*init)(void);   // set up the hardware
+	void (*start)(void);  // start (or resume) delivering blocks
+	void (*stop)(void);   // pause delivering blocks
+
+	// the oldest complete block or NULL; valid until release_block()
+	const struct audio_block* (*get_block)(void);
+	void (*release_block)(void);
+
+	uint32_t (*get_dropped)(void); // number of blocks dropped
+};
+
+// analog microphone at the ADC (PA4)
+extern const struct audio_source audio_source_adc;
+
+// on-board MEMS microphone (PDM)
+extern const struct audio_source audio_source_mp45dt02;
+
+/*
+ * Single-producer/single-consumer queue of blocks for the implementations,
+ * e.g. filled by an interrupt handler and drained by the main loop without any
+ * critical section. widx and ridx run freely and are only masked on access,
+ * so all AUDIO_QUEUE_BLOCKS entries are usable. Each index is written by one
+ * side only and published with release semantics after the data.
+ */
+struct audio_queue {
+	struct audio_block blocks[AUDIO_QUEUE_BLOCKS];
+
+	uint32_t widx; // written by the producer
+	uint32_t ridx; // written by the consumer
+
+	uint32_t next_timestamp; // producer only
+	uint32_t dropped;
+};
+
+void audio_queue_init(struct audio_queue *queue);
+
+// calculate block->mean for sources which do not get it from their conversion
+void audio_block_update_mean(struct audio_block *block);
+
+/*
+ * Producer: get the next free block to be filled and committed with
+ * audio_queue_commit(). If the queue is full, the block is counted as dropped
+ * and NULL is returned.
+ */
+struct audio_block* audio_queue_begin_write(struct audio_queue *queue);
+void audio_queue_commit(struct audio_queue *queue);
+
+// consumer
+const struct audio_block* audio_queue_peek(struct audio_queue *queue);
+void audio_queue_release(struct audio_queue *queue);
+
+uint32_t audio_queue_get_dropped(struct audio_queue *queue);
+
+#endif // AUDIO_SOURCE_H
@@ -1,6 +1,8 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include <stdint.h>
+
 #define FFT_EXPONENT     8
 
 // length of the transformed block (input and output length)
@@ -9,9 +11,97 @@
 // length of the useful FFT result data (due to symmetry)
 #define FFT_DATALEN      (FFT_BLOCK_LEN/2 + 1)
 
+// audio input used by the firmware (see audio_source.h):
+// - AUDIO_SOURCE_ADC: analog microphone at the ADC, 40 kHz
+// - AUDIO_SOURCE_MP45DT02: on-board MEMS microphone, 48 kHz
+#define AUDIO_SOURCE_ADC      0
+#define AUDIO_SOURCE_MP45DT02 1
+
+#ifndef AUDIO_SOURCE
+#define AUDIO_SOURCE     AUDIO_SOURCE_ADC
+#endif
+
+#if AUDIO_SOURCE == AUDIO_SOURCE_MP45DT02
+#define SAMPLE_RATE      48000
+#else
 #define SAMPLE_RATE      40000
+#endif
+
+// corner frequency of the DC removal of the ADC samples in Hz (see
+// adc_convert.h)
+#define ADC_DC_CORNER_FREQ 1.0f
+
+// rate of the LED frames in Hz, independent of the analysis rate (see
+// led_output.h). A frame takes about 1.6 ms on the SPI plus 0.5 ms for the
+// WS2801 to latch, so it should not exceed about 400.
+#define LED_FRAME_RATE   200
+
+// gamma correction of the LED output: PWM value = 255 * x^LED_GAMMA for the
+// linear brightness x. The table (generated by gen_lut.py) is indexed with the
+// top LED_GAMMA_BITS of a 16 bit value, at most 16.
+#define LED_GAMMA        2.0f
+#define LED_GAMMA_BITS   10
+
+// the spectrum is updated every STFT_HOP_SIZE samples (see fft/stft.h). Must
+// divide FFT_BLOCK_LEN.
+#define STFT_HOP_EXPONENT 6
+#define STFT_HOP_SIZE    (1 << STFT_HOP_EXPONENT)
+
+// kernel used for the complex FFT inside fft_transform_real():
+// - FFT_KERNEL_RADIX2: radix-2 layers, twiddles looked up in lut.h per butterfly
+// - FFT_KERNEL_RADIX4: radix-4 stages (plus one radix-2 stage for odd
+//   exponents) with per-stage twiddle tables generated by gen_lut.py
+#define FFT_KERNEL_RADIX2 0
+#define FFT_KERNEL_RADIX4 1
+
+#ifndef FFT_KERNEL
+#define FFT_KERNEL       FFT_KERNEL_RADIX4
+#endif
+
+// magnitude stage of the float pipeline (used by musiclight()):
+// - FFT_MAGNITUDE_SQRT:   exact |X| (hardware square root)
+// - FFT_MAGNITUDE_POWER:  |X|^2, no square root at all. The denoiser and the
+//                         band energies then work on the power spectrum.
+// - FFT_MAGNITUDE_APPROX: alpha-max-plus-beta-min estimate of |X| (max. error 4 %)
+#define FFT_MAGNITUDE_SQRT   0
+#define FFT_MAGNITUDE_POWER  1
+#define FFT_MAGNITUDE_APPROX 2
+
+#ifndef FFT_MAGNITUDE
+#define FFT_MAGNITUDE    FFT_MAGNITUDE_SQRT
+#endif
+
+// highest frequency analysed by the sliding DFT (fft/sdft.h)
+#define SDFT_MAX_FREQ    10000
+
+// let musiclight() read the spectrum from the sliding DFT, which is updated
+// with every sample, instead of running the block FFT (float only)
+//#define MUSICLIGHT_SDFT
+
+// analyse the low bands of musiclight() with a second FFT of the signal
+// decimated by 8 (see fft/decimator.h), for 8 times the frequency resolution
+// in the bass range. Requires the block FFT.
+#ifndef MUSICLIGHT_SDFT
+#define MUSICLIGHT_MULTIRATE
+#endif
+
+// use the Q15 fixed-point pipeline (fft/fft_q15.c) instead of the float one
+//#define FFT_FIXED_POINT
+
+// places DSP working buffers in the core coupled memory of the STM32F4 (see
+// the linker scripts). Only for buffers that are never accessed by DMA.
+#ifdef STM32F4
+#define CCMRAM __attribute__((section(".ccmram")))
+#else
+#define CCMRAM
+#endif
 
 typedef float fft_value_type;
+
+#ifdef FFT_FIXED_POINT
+typedef int16_t fft_sample; // Q15
+#else
 typedef float fft_sample;
+#endif
 
 #endif // CONFIG_H
@@ -0,0 +1,102 @@
+/*
+ * vim: sw=2 ts=2 expandtab
+ *
+ * Decimating lowpass filter. See decimator.h.
+ */
+
+#include <math.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "constants.h"
+
+#include "decimator.h"
+
+void decimator_init(struct decimator_ctx *ctx) {
+  // cutoff relative to the input sample rate
+  const float fc = 0.4f / DECIMATOR_FACTOR;
+  float coef[DECIMATOR_TAPS];
+  float sum = 0;
+  int i;
+
+  for(i = 0; i < DECIMATOR_TAPS; i++) {
+    float n = i - (DECIMATOR_TAPS - 1) / 2.0f;
+    float x = 2 * PI * i / (DECIMATOR_TAPS - 1);
+    float window = 0.42f - 0.5f * cosf(x) + 0.08f * cosf(2 * x);
+
+    // the number of taps is even, so n is never 0
+    coef[i] = sinf(2 * PI * fc * n) / (PI * n) * window;
+    sum += coef[i];
+  }
+
+  // unity gain at DC
+  for(i = 0; i < DECIMATOR_TAPS; i++) {
+#ifdef FFT_FIXED_POINT
+    ctx->coef[i] = (decimator_coef)lrintf(coef[i] / sum * 32767.0f);
+#else
+    ctx->coef[i] = coef[i] / sum;
+#endif
+  }
+
+  for(i = 0; i < 2 * DECIMATOR_TAPS; i++) {
+    ctx->history[i] = 0;
+  }
+
+  ctx->pos = 0;
+  ctx->phase = DECIMATOR_FACTOR;
+}
+
+static fft_sample decimator_output(const struct decimator_ctx *ctx) {
+  const fft_sample *x = &ctx->history[ctx->pos];
+  int i;
+
+#ifdef FFT_FIXED_POINT
+  int32_t acc = 1 << 14;
+
+  for(i = 0; i < DECIMATOR_TAPS; i++) {
+    acc += (int32_t)ctx->coef[i] * x[i];
+  }
+
+  acc >>= 15;
+
+  if(acc > 32767) {
+    acc = 32767;
+  } else if(acc < -32768) {
+    acc = -32768;
+  }
+
+  return acc;
+#else
+  fft_value_type acc = 0;
+
+  for(i = 0; i < DECIMATOR_TAPS; i++) {
+    acc += ctx->coef[i] * x[i];
+  }
+
+  return acc;
+#endif
+}
+
+uint32_t decimator_process(struct decimator_ctx *ctx, const fft_sample *in, uint32_t n,
+    fft_sample *out) {
+  uint32_t count = 0;
+  uint32_t i;
+
+  for(i = 0; i < n; i++) {
+    ctx->history[ctx->pos] = in[i];
+    ctx->history[ctx->pos + DECIMATOR_TAPS] = in[i];
+
+    ctx->pos++;
+    if(ctx->pos == DECIMATOR_TAPS) {
+      ctx->pos = 0;
+    }
+
+    ctx->phase--;
+    if(ctx->phase == 0) {
+      ctx->phase = DECIMATOR_FACTOR;
+      out[count++] = decimator_output(ctx);
+    }
+  }
+
+  return count;
+}
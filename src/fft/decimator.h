@@ -0,0 +1,62 @@
+/*
+ * vim: sw=2 ts=2 expandtab
+ *
+ * Decimation of the input signal by DECIMATOR_FACTOR for the analysis of the
+ * low frequencies with a second FFT (see MUSICLIGHT_MULTIRATE in config.h).
+ *
+ * A FFT_BLOCK_LEN point FFT of the decimated signal has DECIMATOR_FACTOR
+ * times the frequency resolution of the full rate FFT, at the cost of one
+ * short FIR filter per output sample.
+ *
+ * The lowpass is a Blackman windowed sinc with DECIMATOR_TAPS taps and the
+ * cutoff at 0.4 times the output sample rate. Only every DECIMATOR_FACTOR-th
+ * output is calculated (the polyphase form of the filter), so the cost per
+ * input sample is DECIMATOR_TAPS / DECIMATOR_FACTOR multiply-adds. At 40 kHz
+ * input, the passband up to 400 Hz is flat within 0.2 dB and everything that
+ * aliases into it is attenuated by more than 70 dB.
+ */
+
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+#define DECIMATOR_FACTOR 8
+#define DECIMATOR_TAPS   48
+
+#define DECIMATOR_SAMPLE_RATE (SAMPLE_RATE / DECIMATOR_FACTOR)
+
+#if (DECIMATOR_TAPS % DECIMATOR_FACTOR) != 0
+#error "DECIMATOR_TAPS must be a multiple of DECIMATOR_FACTOR"
+#endif
+
+#ifdef FFT_FIXED_POINT
+typedef int16_t decimator_coef; // Q15
+#else
+typedef fft_value_type decimator_coef;
+#endif
+
+struct decimator_ctx {
+  decimator_coef coef[DECIMATOR_TAPS];
+
+  // the history is stored twice in a row like in stft.h
+  fft_sample history[2 * DECIMATOR_TAPS];
+
+  uint32_t pos;    // index of the oldest sample
+  uint32_t phase;  // input samples until the next output
+};
+
+void decimator_init(struct decimator_ctx *ctx);
+
+/*!
+ * Filter and decimate n input samples.
+ *
+ * \param out  Room for n / DECIMATOR_FACTOR + 1 samples.
+ * \returns    The number of output samples.
+ */
+uint32_t decimator_process(struct decimator_ctx *ctx, const fft_sample *in, uint32_t n,
+    fft_sample *out);
+
+#endif // DECIMATOR_H
@@ -18,39 +18,118 @@
 #include "lut.h"
 #include "fft.h"
 
-fft_value_type window_buffer[FFT_BLOCK_LEN];
-int lookup_table[FFT_BLOCK_LEN];
+#if FFT_KERNEL == FFT_KERNEL_RADIX4
+// exponent of the complex transform inside fft_transform_real()
+#define RADIX4_EXPONENT     (FFT_EXPONENT - 1)
+#define RADIX4_NUM_STAGES   (RADIX4_EXPONENT / 2)
+
+// sum of the butterfly spans of all radix-4 stages (1 + 4 + 16 + ..., times 2
+// if a radix-2 stage comes first)
+#define RADIX4_NUM_TWIDDLES \
+  ((((1 << (2 * RADIX4_NUM_STAGES)) - 1) / 3) << (RADIX4_EXPONENT % 2))
+
+// The twiddle factors for the radix-4 stages (radix4_twiddles in lut.h) are
+// stored one stage after the other. For each element j of a stage with span s,
+// W^j, W^2j and W^3j (W = exp(-2*pi*i/(4s))) are stored as re/im pairs, so the
+// butterfly loop just walks through memory.
+#if RADIX4_TWIDDLE_LEN != 6 * RADIX4_NUM_TWIDDLES
+#error "radix4_twiddles in lut.h does not match the radix-4 stages"
+#endif
+#endif
 
+/*
+ * Bit-reversed index (FFT_EXPONENT-1 bits) of an element of the half-size
+ * complex transform. The Cortex-M4 has an instruction for it (RBIT), so no
+ * table access is needed there.
+ */
+static inline uint32_t bitrev_half(uint32_t i) {
+#if defined(__ARM_ARCH_7EM__)
+  uint32_t r;
+
+  __asm__ ("rbit %0, %1" : "=r" (r) : "r" (i));
+  return r >> (32 - (FFT_EXPONENT - 1));
+#else
+  return lookup_table[i] >> 1;
+#endif
+}
 
-void fft_init(void) {
-  int i = 0;
-  int ri, b;
+static inline fft_value_type magnitude_absolute(fft_value_type re, fft_value_type im) {
+  // sqrtf() compiles to a single vsqrt.f32 with -fno-math-errno
+  return sqrtf(re*re + im*im);
+}
 
-  for(i = 0; i < FFT_BLOCK_LEN; i++) {
-    window_buffer[i] = 0.5 * (1 - cos(2 * PI * i / FFT_BLOCK_LEN));
-  }
+static inline fft_value_type magnitude_power(fft_value_type re, fft_value_type im) {
+  return re*re + im*im;
+}
 
-  for(i = 0; i < FFT_BLOCK_LEN; i++) {
-    ri = 0;
+// coefficients for the smallest maximum error (3.96 %)
+#define ALPHA_MAX_BETA_MIN_ALPHA 0.96043387f
+#define ALPHA_MAX_BETA_MIN_BETA  0.39782473f
 
-    for(b = 0; b < FFT_EXPONENT; b++)
-      ri |= ((i >> b) & 1) << (FFT_EXPONENT - b - 1);
+static inline fft_value_type magnitude_absolute_approx(fft_value_type re, fft_value_type im) {
+  fft_value_type a = fabsf(re);
+  fft_value_type b = fabsf(im);
 
-    lookup_table[i] = ri;
+  if(a > b) {
+    return ALPHA_MAX_BETA_MIN_ALPHA * a + ALPHA_MAX_BETA_MIN_BETA * b;
+  } else {
+    return ALPHA_MAX_BETA_MIN_ALPHA * b + ALPHA_MAX_BETA_MIN_BETA * a;
   }
 }
 
+void fft_complex_to_absolute(fft_value_type *re, fft_value_type *im, fft_value_type *result) {
+  int i;
 
+  for(i = 0; i < FFT_DATALEN; i++)
+  {
+    result[i] = magnitude_absolute(re[i], im[i]);
+  }
+}
 
-void fft_complex_to_absolute(fft_value_type *re, fft_value_type *im, fft_value_type *result) {
+void fft_complex_to_power(fft_value_type *re, fft_value_type *im, fft_value_type *result) {
   int i;
 
   for(i = 0; i < FFT_DATALEN; i++)
   {
-    result[i] = sqrt( re[i]*re[i] + im[i]*im[i] );
+    result[i] = magnitude_power(re[i], im[i]);
   }
 }
 
+void fft_complex_to_absolute_approx(fft_value_type *re, fft_value_type *im, fft_value_type *result) {
+  int i;
+
+  for(i = 0; i < FFT_DATALEN; i++)
+  {
+    result[i] = magnitude_absolute_approx(re[i], im[i]);
+  }
+}
+
+// the real DC and Nyquist bins are stored in the first pair of a packed
+// spectrum, the other bins are read through the bit-reversed index, see fft.h
+#define PACKED_TO_MAGNITUDE(buf, result, magnitude) \
+  do { \
+    int i; \
+    uint32_t p; \
+    result[0] = magnitude(buf[0], 0); \
+    result[FFT_BLOCK_LEN/2] = magnitude(buf[1], 0); \
+    for(i = 1; i < FFT_BLOCK_LEN/2; i++) { \
+      p = 2 * bitrev_half(i); \
+      result[i] = magnitude(buf[p], buf[p + 1]); \
+    } \
+  } while(0)
+
+void fft_packed_to_absolute(const fft_value_type *buf, fft_value_type *result) {
+  PACKED_TO_MAGNITUDE(buf, result, magnitude_absolute);
+}
+
+void fft_packed_to_power(const fft_value_type *buf, fft_value_type *result) {
+  PACKED_TO_MAGNITUDE(buf, result, magnitude_power);
+}
+
+void fft_packed_to_absolute_approx(const fft_value_type *buf, fft_value_type *result) {
+  PACKED_TO_MAGNITUDE(buf, result, magnitude_absolute_approx);
+}
+
 
 
 void fft_apply_window(fft_sample *dftinput) {
@@ -131,6 +210,386 @@ void fft_transform(fft_sample *samples, fft_value_type *resultRe, fft_value_type
   }
 }
 
+#if FFT_KERNEL == FFT_KERNEL_RADIX2
+/*
+ * Complex radix-2 decimation-in-time FFT on 2^exponent points. The input must
+ * already be in bit-reversed order. The twiddle factor is applied to the
+ * right (odd) half of each butterfly, so the result is the correct DFT (not
+ * only in magnitude).
+ *
+ * Element i is re[i*stride], im[i*stride]: stride is 1 for separate arrays and
+ * 2 for an interleaved buffer (im = re + 1). It is a constant in both callers,
+ * so the function is specialised for each layout when inlined.
+ */
+static inline void fft_complex_radix2(fft_value_type *re, fft_value_type *im, const int stride, int exponent) {
+  int layer, part, element;
+  int num_parts, num_elements;
+
+  int left, right;
+
+  fft_value_type t_re, t_im;
+  fft_value_type sinval, cosval;
+
+  for(layer = 0; layer < exponent; layer++)
+  {
+    num_parts = 1 << (exponent - layer - 1);
+    num_elements = (1 << layer);
+
+    for(part = 0; part < num_parts; part++)
+    {
+      for(element = 0; element < num_elements; element++)
+      {
+        left = ((1 << (layer + 1)) * part + element) * stride;
+        right = left + (1 << layer) * stride;
+
+        sinval = lookup_sin(layer, element);
+        cosval = lookup_cos(layer, element);
+
+        // t = W * x_right
+        t_re = re[right] * cosval - im[right] * sinval;
+        t_im = im[right] * cosval + re[right] * sinval;
+
+        re[right] = re[left] - t_re;
+        im[right] = im[left] - t_im;
+        re[left] += t_re;
+        im[left] += t_im;
+      }
+    }
+  }
+}
+
+/*
+ * Decimation-in-frequency counterpart of fft_complex_radix2(): the same
+ * butterflies transposed and in reverse layer order. The input is in natural
+ * order, the output in bit-reversed order.
+ */
+static inline void fft_complex_radix2_dif(fft_value_type *re, fft_value_type *im, const int stride, int exponent) {
+  int layer, part, element;
+  int num_parts, num_elements;
+
+  int left, right;
+
+  fft_value_type d_re, d_im;
+  fft_value_type sinval, cosval;
+
+  for(layer = exponent - 1; layer >= 0; layer--)
+  {
+    num_parts = 1 << (exponent - layer - 1);
+    num_elements = (1 << layer);
+
+    for(part = 0; part < num_parts; part++)
+    {
+      for(element = 0; element < num_elements; element++)
+      {
+        left = ((1 << (layer + 1)) * part + element) * stride;
+        right = left + (1 << layer) * stride;
+
+        sinval = lookup_sin(layer, element);
+        cosval = lookup_cos(layer, element);
+
+        // x_right = W * (x_left - x_right)
+        d_re = re[left] - re[right];
+        d_im = im[left] - im[right];
+
+        re[left] += re[right];
+        im[left] += im[right];
+        re[right] = d_re * cosval - d_im * sinval;
+        im[right] = d_im * cosval + d_re * sinval;
+      }
+    }
+  }
+}
+#endif
+
+#if FFT_KERNEL == FFT_KERNEL_RADIX4
+/*
+ * Complex FFT on 2^RADIX4_EXPONENT points using radix-4 decimation-in-time
+ * stages. For odd exponents a twiddle-free radix-2 stage is done first. The
+ * input must be in (radix-2) bit-reversed order. See fft_complex_radix2() for
+ * the stride.
+ */
+static inline void fft_complex_radix4(fft_value_type *re, fft_value_type *im, const int stride) {
+  int s, j, g;
+  int i0, i1, i2, i3;
+
+  const fft_value_type *tw = radix4_twiddles;
+
+  fft_value_type w1_re, w1_im, w2_re, w2_im, w3_re, w3_im;
+  fft_value_type t0_re, t0_im, t1_re, t1_im, t2_re, t2_im, t3_re, t3_im;
+  fft_value_type u0_re, u0_im, u1_re, u1_im, u2_re, u2_im, u3_re, u3_im;
+
+#if RADIX4_EXPONENT % 2 == 1
+  for(i0 = 0; i0 < (1 << RADIX4_EXPONENT) * stride; i0 += 2 * stride) {
+    i1 = i0 + stride;
+
+    t0_re = re[i0];
+    t0_im = im[i0];
+
+    re[i0] = t0_re + re[i1];
+    im[i0] = t0_im + im[i1];
+    re[i1] = t0_re - re[i1];
+    im[i1] = t0_im - im[i1];
+  }
+#endif
+
+  for(s = 1 << (RADIX4_EXPONENT % 2); s < (1 << RADIX4_EXPONENT); s *= 4) {
+    for(j = 0; j < s; j++) {
+      w1_re = tw[0]; w1_im = tw[1];
+      w2_re = tw[2]; w2_im = tw[3];
+      w3_re = tw[4]; w3_im = tw[5];
+      tw += 6;
+
+      for(g = j; g < (1 << RADIX4_EXPONENT); g += 4 * s) {
+        i0 = g * stride;
+        i1 = i0 + s * stride;
+        i2 = i1 + s * stride;
+        i3 = i2 + s * stride;
+
+        // the quarters hold the sub-DFTs of the input elements with index
+        // 0, 2, 1 and 3 (mod 4), so x[i2] gets W^j and x[i1] gets W^2j
+        t0_re = re[i0];
+        t0_im = im[i0];
+        t1_re = re[i2] * w1_re - im[i2] * w1_im;
+        t1_im = im[i2] * w1_re + re[i2] * w1_im;
+        t2_re = re[i1] * w2_re - im[i1] * w2_im;
+        t2_im = im[i1] * w2_re + re[i1] * w2_im;
+        t3_re = re[i3] * w3_re - im[i3] * w3_im;
+        t3_im = im[i3] * w3_re + re[i3] * w3_im;
+
+        u0_re = t0_re + t2_re;
+        u0_im = t0_im + t2_im;
+        u1_re = t0_re - t2_re;
+        u1_im = t0_im - t2_im;
+        u2_re = t1_re + t3_re;
+        u2_im = t1_im + t3_im;
+        u3_re = t1_re - t3_re;
+        u3_im = t1_im - t3_im;
+
+        re[i0] = u0_re + u2_re;
+        im[i0] = u0_im + u2_im;
+        re[i1] = u1_re + u3_im;
+        im[i1] = u1_im - u3_re;
+        re[i2] = u0_re - u2_re;
+        im[i2] = u0_im - u2_im;
+        re[i3] = u1_re - u3_im;
+        im[i3] = u1_im + u3_re;
+      }
+    }
+  }
+}
+
+/*
+ * Decimation-in-frequency counterpart of fft_complex_radix4(): the transposed
+ * butterflies (twiddles applied to the outputs) in reverse stage order, with
+ * the radix-2 stage for odd exponents done last. The input is in natural
+ * order, the output in (radix-2) bit-reversed order.
+ */
+static inline void fft_complex_radix4_dif(fft_value_type *re, fft_value_type *im, const int stride) {
+  int s, j, g;
+  int i0, i1, i2, i3;
+
+  const fft_value_type *tw;
+
+  fft_value_type w1_re, w1_im, w2_re, w2_im, w3_re, w3_im;
+  fft_value_type t0_re, t0_im;
+  fft_value_type u0_re, u0_im, u1_re, u1_im, u2_re, u2_im, u3_re, u3_im;
+  fft_value_type v_re, v_im;
+
+  for(s = (1 << RADIX4_EXPONENT) / 4; s >= (1 << (RADIX4_EXPONENT % 2)); s /= 4) {
+    // the twiddles of the stages with smaller spans come first in the table
+    tw = radix4_twiddles + 2 * (s - (1 << (RADIX4_EXPONENT % 2)));
+
+    for(j = 0; j < s; j++) {
+      w1_re = tw[0]; w1_im = tw[1];
+      w2_re = tw[2]; w2_im = tw[3];
+      w3_re = tw[4]; w3_im = tw[5];
+      tw += 6;
+
+      for(g = j; g < (1 << RADIX4_EXPONENT); g += 4 * s) {
+        i0 = g * stride;
+        i1 = i0 + s * stride;
+        i2 = i1 + s * stride;
+        i3 = i2 + s * stride;
+
+        u0_re = re[i0] + re[i2];
+        u0_im = im[i0] + im[i2];
+        u1_re = re[i0] - re[i2];
+        u1_im = im[i0] - im[i2];
+        u2_re = re[i1] + re[i3];
+        u2_im = im[i1] + im[i3];
+        u3_re = re[i1] - re[i3];
+        u3_im = im[i1] - im[i3];
+
+        // 4-point DFT, the outputs 1 and 2 swap places (see above)
+        re[i0] = u0_re + u2_re;
+        im[i0] = u0_im + u2_im;
+
+        v_re = u0_re - u2_re;
+        v_im = u0_im - u2_im;
+        re[i1] = v_re * w2_re - v_im * w2_im;
+        im[i1] = v_im * w2_re + v_re * w2_im;
+
+        v_re = u1_re + u3_im;
+        v_im = u1_im - u3_re;
+        re[i2] = v_re * w1_re - v_im * w1_im;
+        im[i2] = v_im * w1_re + v_re * w1_im;
+
+        v_re = u1_re - u3_im;
+        v_im = u1_im + u3_re;
+        re[i3] = v_re * w3_re - v_im * w3_im;
+        im[i3] = v_im * w3_re + v_re * w3_im;
+      }
+    }
+  }
+
+#if RADIX4_EXPONENT % 2 == 1
+  for(i0 = 0; i0 < (1 << RADIX4_EXPONENT) * stride; i0 += 2 * stride) {
+    i1 = i0 + stride;
+
+    t0_re = re[i0];
+    t0_im = im[i0];
+
+    re[i0] = t0_re + re[i1];
+    im[i0] = t0_im + im[i1];
+    re[i1] = t0_re - re[i1];
+    im[i1] = t0_im - im[i1];
+  }
+#endif
+}
+#endif
+
+/*
+ * Complex FFT of half the block size, in the kernel selected in config.h. The
+ * input must be in bit-reversed order.
+ */
+static inline void fft_complex_half(fft_value_type *re, fft_value_type *im, const int stride) {
+#if FFT_KERNEL == FFT_KERNEL_RADIX4
+  fft_complex_radix4(re, im, stride);
+#else
+  fft_complex_radix2(re, im, stride, FFT_EXPONENT - 1);
+#endif
+}
+
+/*
+ * Same with decimation in frequency: the input is in natural order, the output
+ * in bit-reversed order.
+ */
+static inline void fft_complex_half_dif(fft_value_type *re, fft_value_type *im, const int stride) {
+#if FFT_KERNEL == FFT_KERNEL_RADIX4
+  fft_complex_radix4_dif(re, im, stride);
+#else
+  fft_complex_radix2_dif(re, im, stride, FFT_EXPONENT - 1);
+#endif
+}
+
+/*
+ * Split pass of the real FFT for the bins 0 < k < FFT_BLOCK_LEN/2. The bins k
+ * and N/2-k depend on the same two complex values, so they are calculated
+ * together in place. See fft_complex_radix2() for the stride. With bitrev set,
+ * Z and X are stored in bit-reversed order.
+ *
+ * E[k] = (Z[k] + conj(Z[N/2-k])) / 2
+ * O[k] = (Z[k] - conj(Z[N/2-k])) / 2j
+ * X[k] = E[k] + W^k * O[k]
+ */
+static inline void fft_split_real(fft_value_type *re, fft_value_type *im, const int stride, const int bitrev) {
+  int k;
+  int lo, hi;
+
+  fft_value_type a_re, a_im, b_re, b_im;
+  fft_value_type e_re, e_im, o_re, o_im;
+  fft_value_type sinval, cosval;
+
+  for(k = 1; k <= FFT_BLOCK_LEN/4; k++)
+  {
+    if(bitrev) {
+      lo = bitrev_half(k) * stride;
+      hi = bitrev_half(FFT_BLOCK_LEN/2 - k) * stride;
+    } else {
+      lo = k * stride;
+      hi = (FFT_BLOCK_LEN/2 - k) * stride;
+    }
+
+    a_re = re[lo];
+    a_im = im[lo];
+    b_re = re[hi];
+    b_im = im[hi];
+
+    // bin k
+    e_re = 0.5f * (a_re + b_re);
+    e_im = 0.5f * (a_im - b_im);
+    o_re = 0.5f * (a_im + b_im);
+    o_im = 0.5f * (b_re - a_re);
+
+    sinval = lookup_sin(FFT_EXPONENT - 1, k);
+    cosval = lookup_cos(FFT_EXPONENT - 1, k);
+
+    re[lo] = e_re + o_re * cosval - o_im * sinval;
+    im[lo] = e_im + o_im * cosval + o_re * sinval;
+
+    // bin N/2-k: E and O are mirrored (conjugated) and W^(N/2-k) = -conj(W^k)
+    re[hi] = e_re - o_re * cosval + o_im * sinval;
+    im[hi] = -e_im + o_im * cosval + o_re * sinval;
+  }
+}
+
+/*
+ * FFT for real input data.
+ *
+ * The FFT_BLOCK_LEN real samples are packed into FFT_BLOCK_LEN/2 complex values
+ * z[n] = x[2n] + j*x[2n+1], which are transformed with a complex FFT of half
+ * the size. A split pass then separates the spectra of the even and odd
+ * samples and combines them to the spectrum of x.
+ *
+ * Only the FFT_DATALEN useful bins are calculated, so resultRe and resultIm
+ * must be FFT_DATALEN elements long.
+ */
+void fft_transform_real(fft_sample *samples, fft_value_type *resultRe, fft_value_type *resultIm) {
+  int i;
+  fft_value_type a_re, a_im;
+
+  // re-arrange the input pairs in bit-reversed order (for FFT_EXPONENT-1 bits)
+  for(i = 0; i < FFT_BLOCK_LEN/2; i++)
+  {
+    resultRe[lookup_table[i] >> 1] = samples[2*i];
+    resultIm[lookup_table[i] >> 1] = samples[2*i + 1];
+  }
+
+  fft_complex_half(resultRe, resultIm, 1);
+
+  // DC and Nyquist bins are real
+  a_re = resultRe[0];
+  a_im = resultIm[0];
+  resultRe[0] = a_re + a_im;
+  resultIm[0] = 0;
+  resultRe[FFT_BLOCK_LEN/2] = a_re - a_im;
+  resultIm[FFT_BLOCK_LEN/2] = 0;
+
+  fft_split_real(resultRe, resultIm, 1, 0);
+}
+
+/*
+ * In-place variant of fft_transform_real(). The sample pairs in buf already
+ * are the interleaved complex values z[n] in natural order, so a decimation-
+ * in-frequency transform needs no reordering pass. Its bit-reversed output is
+ * kept: the split pass and the fft_packed_to_*() functions read it through the
+ * bit-reversed index. See fft.h for the output format.
+ */
+void fft_transform_real_inplace(fft_value_type *buf) {
+  fft_value_type a_re, a_im;
+
+  fft_complex_half_dif(buf, buf + 1, 2);
+
+  // DC and Nyquist bins are real and share the first pair (index 0 is its own
+  // bit reversal)
+  a_re = buf[0];
+  a_im = buf[1];
+  buf[0] = a_re + a_im;
+  buf[1] = a_re - a_im;
+
+  fft_split_real(buf, buf + 1, 2, 1);
+}
+
 uint32_t fft_find_loudest_frequency(fft_value_type *absFFT) {
   int maxPos = 0;
   fft_value_type maxVal = 0;
@@ -13,11 +13,27 @@
 
 #include "config.h"
 
-void fft_init(void);
+// window_buffer and lookup_table are generated by gen_lut.py
+#include "lut.h"
+
 void fft_complex_to_absolute(fft_value_type *re, fft_value_type *im, fft_value_type *result);
+void fft_complex_to_power(fft_value_type *re, fft_value_type *im, fft_value_type *result);
+void fft_complex_to_absolute_approx(fft_value_type *re, fft_value_type *im, fft_value_type *result);
 void fft_apply_window(fft_sample *dftinput);
 void fft_copy_windowed(fft_sample *in, fft_sample *out);
 void fft_transform(fft_sample *samples, fft_value_type *resultRe, fft_value_type *resultIm);
+void fft_transform_real(fft_sample *samples, fft_value_type *resultRe, fft_value_type *resultIm);
+
+// In-place real FFT on FFT_BLOCK_LEN samples. The result is stored packed in
+// the same buffer, with the pairs in bit-reversed order: re/im of bin k in
+// buf[2r] and buf[2r+1] for 0 < k < FFT_BLOCK_LEN/2, where r is k with its
+// FFT_EXPONENT-1 bits reversed (lookup_table[k] >> 1). The real bin 0 is in
+// buf[0] and the real bin FFT_BLOCK_LEN/2 in buf[1]. The fft_packed_to_*()
+// functions calculate all FFT_DATALEN magnitudes from it in natural order.
+void fft_transform_real_inplace(fft_value_type *buf);
+void fft_packed_to_absolute(const fft_value_type *buf, fft_value_type *result);
+void fft_packed_to_power(const fft_value_type *buf, fft_value_type *result);
+void fft_packed_to_absolute_approx(const fft_value_type *buf, fft_value_type *result);
 uint32_t fft_find_loudest_frequency(fft_value_type *absFFT);
 fft_value_type fft_get_energy_in_band(fft_value_type *fft, uint32_t minFreq, uint32_t maxFreq);
 
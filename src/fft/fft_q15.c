@@ -0,0 +1,243 @@
+/*
+ * vim: sw=2 ts=2 expandtab
+ *
+ * Fixed-point (Q15) variant of the FFT pipeline. See fft_q15.h.
+ */
+
+#include <stdint.h>
+
+#include "config.h"
+
+#include "lut.h"
+#include "fft.h"
+#include "fft_q15.h"
+
+// values with a bit pattern (see q15_bits()) above this limit could overflow in
+// an unscaled butterfly
+#define Q15_UNSCALED_LIMIT 0x1FFF
+
+// the packed input pairs must not exceed this limit, so their magnitude stays
+// below 1.0
+#define Q15_INPUT_LIMIT    0x3FFF
+
+/*
+ * Upper bound of the absolute values in a packed word: |x| for positive and
+ * |x|-1 for negative values, ORed together.
+ */
+static inline uint32_t q15_bits(uint32_t x) {
+  int32_t lo = q15_lo(x);
+  int32_t hi = q15_hi(x);
+
+  return (uint32_t)((lo ^ (lo >> 15)) | (hi ^ (hi >> 15)));
+}
+
+static uint32_t isqrt32(uint32_t x) {
+  uint32_t res = 0;
+  uint32_t bit = 1UL << 30;
+
+  while(bit > x) {
+    bit >>= 2;
+  }
+
+  while(bit) {
+    if(x >= res + bit) {
+      x -= res + bit;
+      res = (res >> 1) + bit;
+    } else {
+      res >>= 1;
+    }
+
+    bit >>= 2;
+  }
+
+  return res;
+}
+
+void fft_q15_copy_windowed(const int16_t *in, int16_t *out) {
+  int i;
+
+  for(i = 0; i < FFT_BLOCK_LEN; i++) {
+    out[i] = ((int32_t)in[i] * q15_window[i]) >> 15;
+  }
+}
+
+/*
+ * One radix-2 layer on the packed data. With scale set, all outputs are
+ * divided by 2. Returns the q15_bits() of all outputs.
+ */
+static inline uint32_t q15_layer(uint32_t *data, int layer, const int scale) {
+  int part, element;
+  int left, right;
+
+  uint32_t t, w, l, r;
+  uint32_t bits = 0;
+
+  for(part = 0; part < (1 << (FFT_EXPONENT - layer - 2)); part++) {
+    for(element = 0; element < (1 << layer); element++) {
+      left = (1 << (layer + 1)) * part + element;
+      right = left + (1 << layer);
+
+      w = fft_q15_twiddles[element << (FFT_EXPONENT - layer - 1)];
+      t = q15_cmul(data[right], w);
+
+      if(scale) {
+        l = q15_hadd2(data[left], t);
+        r = q15_hsub2(data[left], t);
+      } else {
+        l = q15_qadd2(data[left], t);
+        r = q15_qsub2(data[left], t);
+      }
+
+      data[left] = l;
+      data[right] = r;
+
+      bits |= q15_bits(l) | q15_bits(r);
+    }
+  }
+
+  return bits;
+}
+
+/*
+ * Split pass of the real-input transform, see fft_transform_real().
+ */
+static inline void q15_split(uint32_t *data, const int scale) {
+  int k;
+  int32_t re, im;
+
+  uint32_t a, bc, e, o, wo, x, y;
+
+  re = q15_lo(data[0]);
+  im = q15_hi(data[0]);
+  data[0] = q15_pack(q15_sat((re + im) >> scale), 0);
+  data[FFT_BLOCK_LEN/2] = q15_pack(q15_sat((re - im) >> scale), 0);
+
+  for(k = 1; k <= FFT_BLOCK_LEN/4; k++) {
+    a = data[k];
+    bc = q15_conj(data[FFT_BLOCK_LEN/2 - k]);
+
+    e = q15_hadd2(a, bc);
+    o = q15_mul_minus_i(q15_hsub2(a, bc));
+    wo = q15_cmul(o, fft_q15_twiddles[k]);
+
+    if(scale) {
+      x = q15_hadd2(e, wo);
+      y = q15_hsub2(e, wo);
+    } else {
+      x = q15_qadd2(e, wo);
+      y = q15_qsub2(e, wo);
+    }
+
+    data[k] = x;
+    data[FFT_BLOCK_LEN/2 - k] = q15_conj(y);
+  }
+}
+
+int fft_q15_transform_loaded(uint32_t *result, uint32_t bits) {
+  int i, layer;
+  int exponent = 0;
+
+  if(bits > Q15_INPUT_LIMIT) {
+    bits = 0;
+    for(i = 0; i < FFT_BLOCK_LEN/2; i++) {
+      result[i] = q15_hadd2(result[i], 0);
+      bits |= q15_bits(result[i]);
+    }
+
+    exponent++;
+  } else {
+    // normalise quiet input to the full range to keep the rounding errors of
+    // the following stages small
+    int shift = 0;
+
+    while((((bits + 1) << (shift + 1)) - 1) <= Q15_INPUT_LIMIT) {
+      shift++;
+    }
+
+    if(shift > 0) {
+      bits = 0;
+      for(i = 0; i < FFT_BLOCK_LEN/2; i++) {
+        result[i] = q15_pack(q15_lo(result[i]) * (1 << shift), q15_hi(result[i]) * (1 << shift));
+        bits |= q15_bits(result[i]);
+      }
+
+      exponent -= shift;
+    }
+  }
+
+  for(layer = 0; layer < FFT_EXPONENT - 1; layer++) {
+    if(bits > Q15_UNSCALED_LIMIT) {
+      bits = q15_layer(result, layer, 1);
+      exponent++;
+    } else {
+      bits = q15_layer(result, layer, 0);
+    }
+  }
+
+  if(bits > Q15_UNSCALED_LIMIT) {
+    q15_split(result, 1);
+    exponent++;
+  } else {
+    q15_split(result, 0);
+  }
+
+  return exponent;
+}
+
+int fft_q15_transform_real(const int16_t *samples, uint32_t *result) {
+  int i;
+  uint32_t bits = 0;
+
+  // pack pairs of real samples into complex values in bit-reversed order
+  for(i = 0; i < FFT_BLOCK_LEN/2; i++) {
+    uint32_t v = q15_pack(samples[2*i], samples[2*i + 1]);
+    result[lookup_table[i] >> 1] = v;
+    bits |= q15_bits(v);
+  }
+
+  return fft_q15_transform_loaded(result, bits);
+}
+
+uint32_t fft_q15_load_windowed(const int16_t *samples, uint32_t *result) {
+  int i;
+  uint32_t bits = 0;
+
+  // like the load in fft_q15_transform_real(), with the window multiply of
+  // fft_q15_copy_windowed()
+  for(i = 0; i < FFT_BLOCK_LEN/2; i++) {
+    int16_t lo = ((int32_t)samples[2*i] * q15_window[2*i]) >> 15;
+    int16_t hi = ((int32_t)samples[2*i + 1] * q15_window[2*i + 1]) >> 15;
+    uint32_t v = q15_pack(lo, hi);
+    result[lookup_table[i] >> 1] = v;
+    bits |= q15_bits(v);
+  }
+
+  return bits;
+}
+
+void fft_q15_complex_to_absolute(const uint32_t *data, int exponent, uint32_t *result) {
+  int i;
+
+  if(exponent >= 0) {
+    for(i = 0; i < FFT_DATALEN; i++) {
+      result[i] = isqrt32(q15_smuad(data[i], data[i])) << exponent;
+    }
+  } else {
+    for(i = 0; i < FFT_DATALEN; i++) {
+      result[i] = isqrt32(q15_smuad(data[i], data[i])) >> -exponent;
+    }
+  }
+}
+
+uint32_t fft_q15_get_energy_in_band(const uint32_t *fft, uint32_t minFreq, uint32_t maxFreq) {
+  int firstBlock = minFreq * FFT_BLOCK_LEN / SAMPLE_RATE;
+  int lastBlock = maxFreq * FFT_BLOCK_LEN / SAMPLE_RATE;
+  int i;
+
+  uint32_t energy = 0;
+  for(i = firstBlock; i < lastBlock; i++) {
+    energy += fft[i];
+  }
+
+  return energy;
+}
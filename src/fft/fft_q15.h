@@ -0,0 +1,189 @@
+/*
+ * vim: sw=2 ts=2 expandtab
+ *
+ * Fixed-point (Q15) variant of the FFT pipeline.
+ *
+ * Complex values are packed into one 32 bit word (real part in the lower,
+ * imaginary part in the upper halfword), so the Cortex-M4 dual 16 bit
+ * instructions can process a complete value at once. The transform uses block
+ * floating point: each stage is scaled down by 2 only if the data could
+ * overflow otherwise, and the number of scaling steps is returned as block
+ * exponent. Quiet input is normalised to the full range first (giving a
+ * negative exponent).
+ */
+
+#ifndef FFT_Q15_H
+#define FFT_Q15_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+// q15_window and the packed twiddles fft_q15_twiddles are generated by gen_lut.py
+#include "lut.h"
+
+/*!
+ * Multiply FFT_BLOCK_LEN Q15 samples with the window function.
+ */
+void fft_q15_copy_windowed(const int16_t *in, int16_t *out);
+
+/*!
+ * FFT of FFT_BLOCK_LEN real Q15 samples.
+ *
+ * \param samples  The input samples.
+ * \param result   FFT_DATALEN packed complex bins.
+ * \returns        The block exponent: the true spectrum is result * 2^exponent.
+ */
+int fft_q15_transform_real(const int16_t *samples, uint32_t *result);
+
+/*!
+ * The same in two steps, with the window applied while loading: the result of
+ * fft_q15_load_windowed() + fft_q15_transform_loaded() equals that of
+ * fft_q15_copy_windowed() + fft_q15_transform_real(), without the windowed
+ * copy.
+ *
+ * fft_q15_load_windowed() packs the windowed samples into result (in
+ * bit-reversed order) and returns a bound of their magnitude, which must be
+ * passed to fft_q15_transform_loaded() together with the same result buffer.
+ */
+uint32_t fft_q15_load_windowed(const int16_t *samples, uint32_t *result);
+int fft_q15_transform_loaded(uint32_t *result, uint32_t bits);
+
+/*!
+ * Calculate the magnitude of the FFT_DATALEN packed bins and scale them by the
+ * block exponent, so results of different blocks can be compared.
+ */
+void fft_q15_complex_to_absolute(const uint32_t *data, int exponent, uint32_t *result);
+
+uint32_t fft_q15_get_energy_in_band(const uint32_t *fft, uint32_t minFreq, uint32_t maxFreq);
+
+/*
+ * Dual 16 bit operations on packed values. On the Cortex-M4 these map to
+ * single DSP instructions, the C fallback gives bit-identical results.
+ */
+
+static inline uint32_t q15_pack(int16_t lo, int16_t hi) {
+  return (uint16_t)lo | ((uint32_t)(uint16_t)hi << 16);
+}
+
+static inline int16_t q15_lo(uint32_t x) {
+  return (int16_t)(x & 0xFFFF);
+}
+
+static inline int16_t q15_hi(uint32_t x) {
+  return (int16_t)(x >> 16);
+}
+
+static inline int16_t q15_sat(int32_t x) {
+  if(x > 32767) {
+    return 32767;
+  } else if(x < -32768) {
+    return -32768;
+  } else {
+    return x;
+  }
+}
+
+#if defined(__ARM_FEATURE_DSP)
+
+static inline uint32_t q15_qadd2(uint32_t a, uint32_t b) {
+  uint32_t r;
+  __asm__("qadd16 %0, %1, %2" : "=r"(r) : "r"(a), "r"(b));
+  return r;
+}
+
+static inline uint32_t q15_qsub2(uint32_t a, uint32_t b) {
+  uint32_t r;
+  __asm__("qsub16 %0, %1, %2" : "=r"(r) : "r"(a), "r"(b));
+  return r;
+}
+
+static inline uint32_t q15_hadd2(uint32_t a, uint32_t b) {
+  uint32_t r;
+  __asm__("shadd16 %0, %1, %2" : "=r"(r) : "r"(a), "r"(b));
+  return r;
+}
+
+static inline uint32_t q15_hsub2(uint32_t a, uint32_t b) {
+  uint32_t r;
+  __asm__("shsub16 %0, %1, %2" : "=r"(r) : "r"(a), "r"(b));
+  return r;
+}
+
+// lo(a)*lo(b) - hi(a)*hi(b)
+static inline int32_t q15_smusd(uint32_t a, uint32_t b) {
+  int32_t r;
+  __asm__("smusd %0, %1, %2" : "=r"(r) : "r"(a), "r"(b));
+  return r;
+}
+
+// lo(a)*hi(b) + hi(a)*lo(b)
+static inline int32_t q15_smuadx(uint32_t a, uint32_t b) {
+  int32_t r;
+  __asm__("smuadx %0, %1, %2" : "=r"(r) : "r"(a), "r"(b));
+  return r;
+}
+
+// lo(a)*lo(b) + hi(a)*hi(b), interpreted as unsigned (cannot overflow then)
+static inline uint32_t q15_smuad(uint32_t a, uint32_t b) {
+  uint32_t r;
+  __asm__("smuad %0, %1, %2" : "=r"(r) : "r"(a), "r"(b));
+  return r;
+}
+
+#else
+
+static inline uint32_t q15_qadd2(uint32_t a, uint32_t b) {
+  return q15_pack(q15_sat(q15_lo(a) + q15_lo(b)), q15_sat(q15_hi(a) + q15_hi(b)));
+}
+
+static inline uint32_t q15_qsub2(uint32_t a, uint32_t b) {
+  return q15_pack(q15_sat(q15_lo(a) - q15_lo(b)), q15_sat(q15_hi(a) - q15_hi(b)));
+}
+
+static inline uint32_t q15_hadd2(uint32_t a, uint32_t b) {
+  return q15_pack((q15_lo(a) + q15_lo(b)) >> 1, (q15_hi(a) + q15_hi(b)) >> 1);
+}
+
+static inline uint32_t q15_hsub2(uint32_t a, uint32_t b) {
+  return q15_pack((q15_lo(a) - q15_lo(b)) >> 1, (q15_hi(a) - q15_hi(b)) >> 1);
+}
+
+static inline int32_t q15_smusd(uint32_t a, uint32_t b) {
+  return (int32_t)q15_lo(a) * q15_lo(b) - (int32_t)q15_hi(a) * q15_hi(b);
+}
+
+static inline int32_t q15_smuadx(uint32_t a, uint32_t b) {
+  return (int32_t)q15_lo(a) * q15_hi(b) + (int32_t)q15_hi(a) * q15_lo(b);
+}
+
+static inline uint32_t q15_smuad(uint32_t a, uint32_t b) {
+  return (uint32_t)((int32_t)q15_lo(a) * q15_lo(b)) + (uint32_t)((int32_t)q15_hi(a) * q15_hi(b));
+}
+
+#endif
+
+/*
+ * Complex multiplication a*w of packed Q15 values. |w| must be < 1.
+ */
+static inline uint32_t q15_cmul(uint32_t a, uint32_t w) {
+  return q15_pack(q15_smusd(a, w) >> 15, q15_smuadx(a, w) >> 15);
+}
+
+/*
+ * Complex conjugate of a packed value (saturating).
+ */
+static inline uint32_t q15_conj(uint32_t a) {
+  int16_t im = q15_hi(a);
+  return q15_pack(q15_lo(a), (im == -32768) ? 32767 : -im);
+}
+
+/*
+ * Multiply a packed value with -i (saturating).
+ */
+static inline uint32_t q15_mul_minus_i(uint32_t a) {
+  int16_t re = q15_lo(a);
+  return q15_pack(q15_hi(a), (re == -32768) ? 32767 : -re);
+}
+
+#endif // FFT_Q15_H
@@ -0,0 +1,264 @@
+/*
+ * vim: sw=2 ts=2 expandtab
+ *
+ * Table-driven filterbank. See filterbank.h.
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+
+#include "filterbank.h"
+
+static filterbank_weight filterbank_to_weight(float w) {
+#ifdef FFT_FIXED_POINT
+  return (filterbank_weight)(w * 65536.0f + 0.5f);
+#else
+  return w;
+#endif
+}
+
+/*
+ * Insert a segment sorted by its first bin, so filterbank_apply() walks
+ * through the magnitudes in order.
+ */
+static struct filterbank_segment* filterbank_add_segment(struct filterbank *fb,
+    uint32_t first_bin, uint32_t num_bins, uint8_t output) {
+  uint32_t i;
+
+  if(fb->num_segments >= FILTERBANK_MAX_SEGMENTS) {
+    return NULL;
+  }
+
+  i = fb->num_segments;
+  while(i > 0 && fb->segments[i-1].first_bin > first_bin) {
+    fb->segments[i] = fb->segments[i-1];
+    i--;
+  }
+
+  fb->segments[i].first_bin = first_bin;
+  fb->segments[i].num_bins = num_bins;
+  fb->segments[i].weights = FILTERBANK_UNIFORM;
+  fb->segments[i].output = output;
+  fb->segments[i].gain = filterbank_to_weight(1.0f);
+
+  fb->num_segments++;
+  return &fb->segments[i];
+}
+
+static int filterbank_add_band(struct filterbank *fb, const struct filterbank_band *band) {
+  uint32_t firstBlock = band->minFreq * FFT_BLOCK_LEN / fb->sample_rate;
+  uint32_t lastBlock = band->maxFreq * FFT_BLOCK_LEN / fb->sample_rate;
+  struct filterbank_segment *seg;
+  uint32_t i;
+
+  if(lastBlock > FFT_DATALEN) {
+    lastBlock = FFT_DATALEN;
+  }
+
+  if(band->shape == FILTERBANK_TRIANGLE) {
+    float lo = band->minFreq;
+    float hi = band->maxFreq;
+    float mid = 0.5f * (lo + hi);
+
+    uint32_t first = 0, count = 0;
+
+    // bins strictly inside the band have a weight > 0
+    for(i = firstBlock; i <= lastBlock && i < FFT_DATALEN; i++) {
+      float f = (float)i * fb->sample_rate / FFT_BLOCK_LEN;
+
+      if(f > lo && f < hi) {
+        if(count == 0) {
+          first = i;
+        }
+        count++;
+      }
+    }
+
+    if(count > 0) {
+      if(fb->num_weights + count > FILTERBANK_MAX_WEIGHTS) {
+        return -1;
+      }
+
+      seg = filterbank_add_segment(fb, first, count, band->output);
+      if(!seg) {
+        return -1;
+      }
+
+      seg->weights = fb->num_weights;
+
+      for(i = first; i < first + count; i++) {
+        float f = (float)i * fb->sample_rate / FFT_BLOCK_LEN;
+        float w = (f < mid) ? (f - lo) / (mid - lo) : (hi - f) / (hi - mid);
+
+        fb->weights[fb->num_weights++] = filterbank_to_weight(w * band->gain);
+      }
+
+      return 0;
+    }
+
+    // bands narrower than a bin get the bin closest to their centre
+    firstBlock = (uint32_t)(mid * FFT_BLOCK_LEN / fb->sample_rate + 0.5f);
+    if(firstBlock >= FFT_DATALEN) {
+      firstBlock = FFT_DATALEN - 1;
+    }
+    lastBlock = firstBlock + 1;
+  }
+
+  if(lastBlock <= firstBlock) {
+    return 0;
+  }
+
+  seg = filterbank_add_segment(fb, firstBlock, lastBlock - firstBlock, band->output);
+  if(!seg) {
+    return -1;
+  }
+
+  seg->gain = filterbank_to_weight(band->gain);
+  return 0;
+}
+
+static void filterbank_clear(struct filterbank *fb, uint32_t sample_rate) {
+  fb->num_segments = 0;
+  fb->num_weights = 0;
+  fb->num_outputs = 0;
+  fb->sample_rate = sample_rate;
+}
+
+int filterbank_init(struct filterbank *fb, const struct filterbank_band *bands, uint32_t num_bands) {
+  return filterbank_init_rate(fb, bands, num_bands, SAMPLE_RATE);
+}
+
+int filterbank_init_rate(struct filterbank *fb, const struct filterbank_band *bands, uint32_t num_bands,
+    uint32_t sample_rate) {
+  uint32_t i;
+
+  filterbank_clear(fb, sample_rate);
+
+  for(i = 0; i < num_bands; i++) {
+    if(bands[i].output >= FILTERBANK_MAX_OUTPUTS) {
+      return -1;
+    }
+
+    if(bands[i].output >= fb->num_outputs) {
+      fb->num_outputs = bands[i].output + 1;
+    }
+
+    if(filterbank_add_band(fb, &bands[i]) != 0) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+static float filterbank_to_scale(float f, enum filterbank_scale scale) {
+  switch(scale) {
+    case FILTERBANK_LOG:
+      return logf(f);
+    case FILTERBANK_MEL:
+      return 2595.0f * log10f(1.0f + f / 700.0f);
+    default:
+      return f;
+  }
+}
+
+static float filterbank_from_scale(float v, enum filterbank_scale scale) {
+  switch(scale) {
+    case FILTERBANK_LOG:
+      return expf(v);
+    case FILTERBANK_MEL:
+      return 700.0f * (powf(10.0f, v / 2595.0f) - 1.0f);
+    default:
+      return v;
+  }
+}
+
+int filterbank_init_spaced(struct filterbank *fb, uint32_t num_bands,
+    uint32_t minFreq, uint32_t maxFreq, enum filterbank_scale scale) {
+  uint32_t i;
+  float lo, hi;
+
+  filterbank_clear(fb, SAMPLE_RATE);
+
+  if(num_bands > FILTERBANK_MAX_OUTPUTS) {
+    return -1;
+  }
+
+  fb->num_outputs = num_bands;
+
+  // log(0) is undefined, start at the first bin instead
+  if(scale == FILTERBANK_LOG && minFreq < SAMPLE_RATE / FFT_BLOCK_LEN) {
+    minFreq = SAMPLE_RATE / FFT_BLOCK_LEN;
+  }
+
+  lo = filterbank_to_scale(minFreq, scale);
+  hi = filterbank_to_scale(maxFreq, scale);
+
+  // band i reaches from edge i to edge i+2 (num_bands + 2 edges)
+  for(i = 0; i < num_bands; i++) {
+    struct filterbank_band band;
+
+    band.minFreq = filterbank_from_scale(lo + (hi - lo) * i / (num_bands + 1), scale) + 0.5f;
+    band.maxFreq = filterbank_from_scale(lo + (hi - lo) * (i + 2) / (num_bands + 1), scale) + 0.5f;
+    band.shape = FILTERBANK_TRIANGLE;
+    band.output = i;
+    band.gain = 1.0f;
+
+    if(filterbank_add_band(fb, &band) != 0) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+void filterbank_apply(const struct filterbank *fb, const filterbank_value *fft, filterbank_value *energy) {
+  const struct filterbank_segment *seg = fb->segments;
+  const struct filterbank_segment *end = fb->segments + fb->num_segments;
+  uint32_t i;
+
+  for(i = 0; i < fb->num_outputs; i++) {
+    energy[i] = 0;
+  }
+
+  for(; seg < end; seg++) {
+    const filterbank_value *x = fft + seg->first_bin;
+
+#ifdef FFT_FIXED_POINT
+    uint64_t acc = 0;
+
+    if(seg->weights == FILTERBANK_UNIFORM) {
+      for(i = 0; i < seg->num_bins; i++) {
+        acc += x[i];
+      }
+      acc *= seg->gain;
+    } else {
+      const filterbank_weight *w = fb->weights + seg->weights;
+      for(i = 0; i < seg->num_bins; i++) {
+        acc += (uint64_t)x[i] * w[i];
+      }
+    }
+
+    energy[seg->output] += acc >> 16;
+#else
+    filterbank_value acc = 0;
+
+    if(seg->weights == FILTERBANK_UNIFORM) {
+      for(i = 0; i < seg->num_bins; i++) {
+        acc += x[i];
+      }
+      acc *= seg->gain;
+    } else {
+      const filterbank_weight *w = fb->weights + seg->weights;
+      for(i = 0; i < seg->num_bins; i++) {
+        acc += x[i] * w[i];
+      }
+    }
+
+    energy[seg->output] += acc;
+#endif
+  }
+}
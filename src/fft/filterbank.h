@@ -0,0 +1,107 @@
+/*
+ * vim: sw=2 ts=2 expandtab
+ *
+ * Table-driven filterbank on the FFT magnitudes.
+ *
+ * A list of bands (frequency ranges with rectangular or triangular weights,
+ * each added to one of the outputs) is converted once into a table of bin
+ * segments sorted by their first bin, plus a sparse weight table for the
+ * triangular bands. filterbank_apply() then calculates all outputs in a
+ * single pass over the magnitudes without any frequency to bin conversion.
+ */
+
+#ifndef FILTERBANK_H
+#define FILTERBANK_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+#define FILTERBANK_MAX_OUTPUTS 32
+
+#define FILTERBANK_MAX_SEGMENTS 64
+
+// every bin can be part of two overlapping triangular bands
+#define FILTERBANK_MAX_WEIGHTS (2 * FFT_DATALEN)
+
+// weights index of segments with the same weight (gain) for all bins
+#define FILTERBANK_UNIFORM 0xFFFF
+
+#ifdef FFT_FIXED_POINT
+// magnitudes from fft_q15_complex_to_absolute(), weights are Q16
+typedef uint32_t filterbank_value;
+typedef uint32_t filterbank_weight;
+#else
+typedef fft_value_type filterbank_value;
+typedef fft_value_type filterbank_weight;
+#endif
+
+enum filterbank_shape {
+  FILTERBANK_RECT,      // weight 1 for minFreq <= f < maxFreq (as fft_get_energy_in_band())
+  FILTERBANK_TRIANGLE   // 0 at minFreq and maxFreq, 1 in the middle
+};
+
+enum filterbank_scale {
+  FILTERBANK_LINEAR,
+  FILTERBANK_LOG,
+  FILTERBANK_MEL
+};
+
+struct filterbank_band {
+  uint32_t minFreq;
+  uint32_t maxFreq;
+  enum filterbank_shape shape;
+  uint8_t output;
+  float gain;
+};
+
+struct filterbank_segment {
+  uint16_t first_bin;
+  uint16_t num_bins;
+  uint16_t weights;   // index into filterbank.weights or FILTERBANK_UNIFORM
+  uint8_t output;
+  filterbank_weight gain;
+};
+
+struct filterbank {
+  struct filterbank_segment segments[FILTERBANK_MAX_SEGMENTS];
+  filterbank_weight weights[FILTERBANK_MAX_WEIGHTS];
+
+  uint32_t num_segments;
+  uint32_t num_weights;
+  uint32_t num_outputs;
+
+  uint32_t sample_rate;  // of the transformed signal
+};
+
+/*!
+ * Build the weight table from a list of bands.
+ *
+ * \returns  0 on success, -1 if the table or the number of outputs is too small.
+ */
+int filterbank_init(struct filterbank *fb, const struct filterbank_band *bands, uint32_t num_bands);
+
+/*!
+ * Like filterbank_init(), for the FFT of a signal with a different sample
+ * rate than SAMPLE_RATE (e.g. after the decimator, see decimator.h).
+ */
+int filterbank_init_rate(struct filterbank *fb, const struct filterbank_band *bands, uint32_t num_bands,
+    uint32_t sample_rate);
+
+/*!
+ * Build a bank of num_bands overlapping triangular bands between minFreq and
+ * maxFreq, spaced evenly on the given scale. Output i is band i.
+ *
+ * \returns  0 on success, -1 if the table or the number of outputs is too small.
+ */
+int filterbank_init_spaced(struct filterbank *fb, uint32_t num_bands,
+    uint32_t minFreq, uint32_t maxFreq, enum filterbank_scale scale);
+
+/*!
+ * Calculate all outputs from FFT_DATALEN magnitudes.
+ *
+ * \param energy  fb->num_outputs results.
+ */
+void filterbank_apply(const struct filterbank *fb, const filterbank_value *fft, filterbank_value *energy);
+
+#endif // FILTERBANK_H
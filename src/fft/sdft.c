@@ -0,0 +1,123 @@
+/*
+ * vim: sw=2 ts=2 expandtab
+ *
+ * Sliding DFT. See sdft.h.
+ */
+
+#include <math.h>
+#include <stdint.h>
+
+#include "config.h"
+
+#include "lut.h"
+#include "sdft.h"
+
+void sdft_init(struct sdft_ctx *ctx) {
+  int i;
+
+  for(i = 0; i < FFT_BLOCK_LEN; i++) {
+    ctx->history[i] = 0;
+  }
+
+  for(i = 0; i <= SDFT_NUM_BINS; i++) {
+    ctx->sum_re[i] = 0;
+    ctx->sum_im[i] = 0;
+    ctx->fresh_re[i] = 0;
+    ctx->fresh_im[i] = 0;
+  }
+
+  ctx->pos = 0;
+}
+
+void sdft_update(struct sdft_ctx *ctx, fft_value_type sample) {
+  int k;
+  uint32_t m = 0;
+
+  fft_value_type diff = sample - ctx->history[ctx->pos];
+
+  ctx->history[ctx->pos] = sample;
+
+  // W^(k*n) for k = 0, 1, 2, ...: step through the table by n
+  for(k = 0; k <= SDFT_NUM_BINS; k++) {
+    fft_value_type wr = twiddle_lut[2*m];
+    fft_value_type wi = twiddle_lut[2*m + 1];
+
+    ctx->sum_re[k] += diff * wr;
+    ctx->sum_im[k] += diff * wi;
+
+    ctx->fresh_re[k] += sample * wr;
+    ctx->fresh_im[k] += sample * wi;
+
+    m = (m + ctx->pos) & (FFT_BLOCK_LEN - 1);
+  }
+
+  ctx->pos = (ctx->pos + 1) & (FFT_BLOCK_LEN - 1);
+
+  if(ctx->pos == 0) {
+    // re-normalise: the fresh sums now cover exactly the current window
+    for(k = 0; k <= SDFT_NUM_BINS; k++) {
+      ctx->sum_re[k] = ctx->fresh_re[k];
+      ctx->sum_im[k] = ctx->fresh_im[k];
+      ctx->fresh_re[k] = 0;
+      ctx->fresh_im[k] = 0;
+    }
+  }
+}
+
+/*
+ * Magnitude of the Hann-windowed bin k (0 <= k < SDFT_NUM_BINS).
+ *
+ * Relative to the oldest sample n0 in the window, the bins are
+ * X_k = W^(-k*n0) * S_k and the window gives 0.5 X_k - 0.25 (X_(k-1) + X_(k+1)).
+ * Taking out the common factor W^(-k*n0) leaves a rotation by W^(+-n0) for
+ * the neighbours only.
+ */
+static inline fft_value_type sdft_windowed_abs(const struct sdft_ctx *ctx, int k,
+    fft_value_type wr, fft_value_type wi) {
+  fft_value_type lre, lim, re, im;
+
+  if(k == 0) {
+    // S_-1 = conj(S_1) for real input
+    lre = ctx->sum_re[1];
+    lim = -ctx->sum_im[1];
+  } else {
+    lre = ctx->sum_re[k-1];
+    lim = ctx->sum_im[k-1];
+  }
+
+  // 0.5 S_k - 0.25 (W^n0 S_(k-1) + W^-n0 S_(k+1))
+  re = 0.5f * ctx->sum_re[k] - 0.25f * (
+      (wr * lre - wi * lim) + (wr * ctx->sum_re[k+1] + wi * ctx->sum_im[k+1]));
+  im = 0.5f * ctx->sum_im[k] - 0.25f * (
+      (wr * lim + wi * lre) + (wr * ctx->sum_im[k+1] - wi * ctx->sum_re[k+1]));
+
+  return sqrtf(re*re + im*im);
+}
+
+void sdft_get_absolute(const struct sdft_ctx *ctx, fft_value_type *result) {
+  int k;
+
+  // ctx->pos is the oldest sample in the window
+  fft_value_type wr = twiddle_lut[2*ctx->pos];
+  fft_value_type wi = twiddle_lut[2*ctx->pos + 1];
+
+  for(k = 0; k < SDFT_NUM_BINS; k++) {
+    result[k] = sdft_windowed_abs(ctx, k, wr, wi);
+  }
+}
+
+fft_value_type sdft_get_energy_in_band(const struct sdft_ctx *ctx, uint32_t minFreq, uint32_t maxFreq) {
+  int firstBlock = minFreq * FFT_BLOCK_LEN / SAMPLE_RATE;
+  int lastBlock = maxFreq * FFT_BLOCK_LEN / SAMPLE_RATE;
+  int i;
+
+  fft_value_type wr = twiddle_lut[2*ctx->pos];
+  fft_value_type wi = twiddle_lut[2*ctx->pos + 1];
+
+  fft_value_type energy = 0;
+  for(i = firstBlock; i < lastBlock; i++) {
+    energy += sdft_windowed_abs(ctx, i, wr, wi);
+  }
+
+  return energy;
+}
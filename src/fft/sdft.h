@@ -0,0 +1,69 @@
+/*
+ * vim: sw=2 ts=2 expandtab
+ *
+ * Sliding DFT over the last FFT_BLOCK_LEN samples for the bins below
+ * SDFT_MAX_FREQ.
+ *
+ * Instead of transforming a complete block at once, every new sample updates
+ * the bins directly, so the work is spread evenly over time and the spectrum
+ * is available at any time. The bins are accumulated without the usual
+ * per-sample rotation:
+ *
+ *   S_k += (x[n] - x[n-N]) * W^(k*n)
+ *
+ * so rounding errors only add up instead of being amplified. To stop this
+ * drift, a second accumulator sums up x[n] * W^(k*n) from scratch. Every N
+ * samples it covers exactly the current window and replaces S_k.
+ *
+ * The Hann window of the block FFT is applied in the frequency domain when
+ * the magnitudes are read, so the results match fft_copy_windowed() +
+ * fft_transform_real() + fft_complex_to_absolute().
+ */
+
+#ifndef SDFT_H
+#define SDFT_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+// number of (windowed) bins provided, starting at DC
+#define SDFT_NUM_BINS (SDFT_MAX_FREQ * FFT_BLOCK_LEN / SAMPLE_RATE)
+
+#if SDFT_NUM_BINS >= FFT_DATALEN
+#error "SDFT_MAX_FREQ must be below SAMPLE_RATE/2"
+#endif
+
+struct sdft_ctx {
+  fft_value_type history[FFT_BLOCK_LEN];
+
+  // sliding sums for the bins 0 .. SDFT_NUM_BINS (one more for the window)
+  fft_value_type sum_re[SDFT_NUM_BINS + 1];
+  fft_value_type sum_im[SDFT_NUM_BINS + 1];
+
+  // sums since the start of the current window period
+  fft_value_type fresh_re[SDFT_NUM_BINS + 1];
+  fft_value_type fresh_im[SDFT_NUM_BINS + 1];
+
+  uint32_t pos; // index of the next sample in history, n mod N
+};
+
+void sdft_init(struct sdft_ctx *ctx);
+
+/*!
+ * Add one sample and update all bins.
+ */
+void sdft_update(struct sdft_ctx *ctx, fft_value_type sample);
+
+/*!
+ * Get the windowed magnitudes of the bins 0 .. SDFT_NUM_BINS-1.
+ */
+void sdft_get_absolute(const struct sdft_ctx *ctx, fft_value_type *result);
+
+/*!
+ * Same as fft_get_energy_in_band(), but only the bins in the band are
+ * calculated. maxFreq must not exceed SDFT_MAX_FREQ.
+ */
+fft_value_type sdft_get_energy_in_band(const struct sdft_ctx *ctx, uint32_t minFreq, uint32_t maxFreq);
+
+#endif // SDFT_H
@@ -0,0 +1,28 @@
+/*
+ * vim: sw=2 ts=2 expandtab
+ *
+ * Streaming short-time Fourier transform input stage. See stft.h.
+ */
+
+#include <stdint.h>
+
+#include "config.h"
+
+#include "stft.h"
+
+void stft_init(struct stft_ctx *ctx) {
+  int i;
+
+  for(i = 0; i < 2 * FFT_BLOCK_LEN; i++) {
+    ctx->history[i] = 0;
+  }
+
+  ctx->pos = 0;
+  ctx->new_samples = 0;
+}
+
+fft_sample* stft_get_block(struct stft_ctx *ctx) {
+  ctx->new_samples = 0;
+
+  return &ctx->history[ctx->pos];
+}
@@ -0,0 +1,66 @@
+/*
+ * vim: sw=2 ts=2 expandtab
+ *
+ * Streaming short-time Fourier transform input stage.
+ *
+ * The last FFT_BLOCK_LEN samples are kept in a history buffer. Every
+ * STFT_HOP_SIZE new samples a complete block is available for the FFT, so the
+ * spectrum is updated once per hop while the frequency resolution still
+ * corresponds to the full block length.
+ *
+ * The history is stored twice in a row (every sample is written at pos and
+ * pos + FFT_BLOCK_LEN), so the current block is always contiguous in memory
+ * and can be read without unwrapping the ring.
+ */
+
+#ifndef STFT_H
+#define STFT_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+#if (FFT_BLOCK_LEN % STFT_HOP_SIZE) != 0
+#error "STFT_HOP_SIZE must divide FFT_BLOCK_LEN"
+#endif
+
+struct stft_ctx {
+  fft_sample history[2 * FFT_BLOCK_LEN];
+
+  uint32_t pos;          // index of the oldest sample in the block
+  uint32_t new_samples;  // samples pushed since the last stft_get_block()
+};
+
+void stft_init(struct stft_ctx *ctx);
+
+/*!
+ * Add one sample to the history.
+ */
+static inline void stft_push(struct stft_ctx *ctx, fft_sample sample) {
+  ctx->history[ctx->pos] = sample;
+  ctx->history[ctx->pos + FFT_BLOCK_LEN] = sample;
+
+  ctx->pos++;
+  if(ctx->pos == FFT_BLOCK_LEN) {
+    ctx->pos = 0;
+  }
+
+  ctx->new_samples++;
+}
+
+/*!
+ * Check whether at least STFT_HOP_SIZE samples were pushed since the last
+ * block was taken.
+ */
+static inline uint8_t stft_hop_ready(const struct stft_ctx *ctx) {
+  return ctx->new_samples >= STFT_HOP_SIZE;
+}
+
+/*!
+ * Get the latest FFT_BLOCK_LEN samples (oldest first) and start a new hop.
+ * The returned pointer points into the history, so the block must be copied
+ * (e.g. by the window function) before the next stft_push().
+ */
+fft_sample* stft_get_block(struct stft_ctx *ctx);
+
+#endif // STFT_H
@@ -0,0 +1,176 @@
+#include <stddef.h>
+
+#include "led_output.h"
+
+#define LED_OUTPUT_FRAC_BITS 15
+#define LED_OUTPUT_FRAC_ONE  (1 << LED_OUTPUT_FRAC_BITS)
+
+#if (LED_OUTPUT_MAX_INTERVAL >> (32 - LED_OUTPUT_FRAC_BITS)) != 0
+#error "LED_OUTPUT_MAX_INTERVAL is too long for the fade position"
+#endif
+
+static uint32_t (*led_output_clock)(void) = NULL;
+
+// fading from led_output_from (shown at led_output_time) to led_output_to
+static struct led_frame led_output_from;
+static struct led_frame led_output_to;
+
+static uint32_t led_output_time;     // of the last submission
+static uint32_t led_output_interval; // between the last two submissions
+
+void led_output_init(uint32_t (*clock)(void))
+{
+	led_output_clock = clock;
+
+	for(uint32_t i = 0; i < WS2801_NUM_MODULES; i++) {
+		led_output_from.r[i] = led_output_to.r[i] = 0;
+		led_output_from.g[i] = led_output_to.g[i] = 0;
+		led_output_from.b[i] = led_output_to.b[i] = 0;
+	}
+
+	led_output_time = clock();
+	led_output_interval = LED_OUTPUT_MAX_INTERVAL;
+}
+
+static inline uint16_t led_output_value(float v)
+{
+	if(v <= 0) {
+		return 0;
+	} else if(v >= 1.0f) {
+		return LED_OUTPUT_MAX;
+	}
+
+	return v * LED_OUTPUT_MAX + 0.5f;
+}
+
+void led_frame_set_colour(struct led_frame *frame, uint8_t module,
+		float red, float green, float blue)
+{
+	frame->r[module] = led_output_value(red);
+	frame->g[module] = led_output_value(green);
+	frame->b[module] = led_output_value(blue);
+}
+
+void led_history_reset(struct led_history *history)
+{
+	for(uint32_t i = 0; i < WS2801_NUM_MODULES; i++) {
+		history->ring.r[i] = 0;
+		history->ring.g[i] = 0;
+		history->ring.b[i] = 0;
+	}
+
+	history->head = 0;
+}
+
+static inline uint32_t led_history_index(const struct led_history *history, uint32_t module)
+{
+	uint32_t idx = history->head + module;
+
+	return (idx < WS2801_NUM_MODULES) ? idx : (idx - WS2801_NUM_MODULES);
+}
+
+void led_history_scroll(struct led_history *history, uint32_t n)
+{
+	// the oldest n colours are dropped and their slots become modules 0 to
+	// n-1, which keep the colours they had
+	history->head = led_history_index(history, WS2801_NUM_MODULES - n);
+
+	for(uint32_t i = 0; i < n; i++) {
+		uint32_t to = led_history_index(history, i);
+		uint32_t from = led_history_index(history, n + i);
+
+		history->ring.r[to] = history->ring.r[from];
+		history->ring.g[to] = history->ring.g[from];
+		history->ring.b[to] = history->ring.b[from];
+	}
+}
+
+void led_history_set_colour(struct led_history *history, uint8_t module,
+		float red, float green, float blue)
+{
+	led_frame_set_colour(&history->ring, led_history_index(history, module),
+			red, green, blue);
+}
+
+void led_history_render(const struct led_history *history, struct led_frame *frame)
+{
+	const struct led_frame *ring = &history->ring;
+	uint32_t first = WS2801_NUM_MODULES - history->head;
+
+	// two linear segments: from the head to the end of the ring, then from the
+	// start of the ring
+	for(uint32_t i = 0; i < first; i++) {
+		frame->r[i] = ring->r[history->head + i];
+		frame->g[i] = ring->g[history->head + i];
+		frame->b[i] = ring->b[history->head + i];
+	}
+
+	for(uint32_t i = first; i < WS2801_NUM_MODULES; i++) {
+		frame->r[i] = ring->r[i - first];
+		frame->g[i] = ring->g[i - first];
+		frame->b[i] = ring->b[i - first];
+	}
+}
+
+// fade position (Q15) at the given time
+static uint32_t led_output_position(uint32_t now)
+{
+	uint32_t elapsed = now - led_output_time;
+
+	if(elapsed >= led_output_interval) {
+		return LED_OUTPUT_FRAC_ONE;
+	}
+
+	return (elapsed << LED_OUTPUT_FRAC_BITS) / led_output_interval;
+}
+
+static inline uint16_t led_output_mix(uint16_t from, uint16_t to, uint32_t pos)
+{
+	// |to - from| * pos < 2^31
+	return from + (((int32_t)to - from) * (int32_t)pos >> LED_OUTPUT_FRAC_BITS);
+}
+
+void led_output_submit(const struct led_frame *frame)
+{
+	uint32_t now = led_output_clock();
+	uint32_t pos = led_output_position(now);
+	uint32_t interval = now - led_output_time;
+
+	// continue from what is shown now, so there is no jump
+	for(uint32_t i = 0; i < WS2801_NUM_MODULES; i++) {
+		led_output_from.r[i] = led_output_mix(led_output_from.r[i], led_output_to.r[i], pos);
+		led_output_from.g[i] = led_output_mix(led_output_from.g[i], led_output_to.g[i], pos);
+		led_output_from.b[i] = led_output_mix(led_output_from.b[i], led_output_to.b[i], pos);
+	}
+
+	led_output_to = *frame;
+
+	if(interval == 0) {
+		interval = 1;
+	} else if(interval > LED_OUTPUT_MAX_INTERVAL) {
+		interval = LED_OUTPUT_MAX_INTERVAL;
+	}
+
+	led_output_time = now;
+	led_output_interval = interval;
+}
+
+void led_output_render(void)
+{
+	static struct led_frame frame;
+	uint32_t pos = led_output_position(led_output_clock());
+
+	// the previous frame is still waiting for the strip (counted as dropped)
+	if(!ws2801_begin_update()) {
+		return;
+	}
+
+	for(uint32_t i = 0; i < WS2801_NUM_MODULES; i++) {
+		frame.r[i] = led_output_mix(led_output_from.r[i], led_output_to.r[i], pos);
+		frame.g[i] = led_output_mix(led_output_from.g[i], led_output_to.g[i], pos);
+		frame.b[i] = led_output_mix(led_output_from.b[i], led_output_to.b[i], pos);
+	}
+
+	ws2801_set_frame(frame.r, frame.g, frame.b);
+	ws2801_send_update();
+}
@@ -0,0 +1,80 @@
+#ifndef LED_OUTPUT_H
+#define LED_OUTPUT_H
+
+#include <stdint.h>
+
+#include "config.h"
+#include "ws2801.h"
+
+/*
+ * LED frame output at a fixed rate (LED_FRAME_RATE, see config.h), decoupled
+ * from the analysis.
+ *
+ * The effects submit a new frame whenever they have an analysis result. The
+ * output renders frames on its own schedule and fades linearly from the
+ * frame shown at the time of the last submission to the submitted one, over
+ * the time between the last two submissions. The motion on the strip is
+ * smooth even if the analysis runs at a lower or irregular rate, at the cost
+ * of one analysis interval of latency.
+ *
+ * The interpolation is done in fixed point: the values are linear brightness
+ * with full scale LED_OUTPUT_MAX, the fade position is Q15. The frames are
+ * passed to ws2801_set_frame(), which does the gamma correction and the
+ * dithering.
+ */
+
+#define LED_OUTPUT_MAX 0xFFFF
+
+// longest fade (in clock units, us): after a longer pause of the analysis,
+// the next frame is reached within this time
+#define LED_OUTPUT_MAX_INTERVAL 100000
+
+struct led_frame {
+	uint16_t r[WS2801_NUM_MODULES];
+	uint16_t g[WS2801_NUM_MODULES];
+	uint16_t b[WS2801_NUM_MODULES];
+};
+
+/*
+ * Scrolling history of colours along the strip, e.g. for effects which show
+ * the newest value at module 0 and move the older ones outwards. The frame is
+ * a ring buffer with a moving head, so scrolling does not move the stored
+ * colours and costs the same for any strip length.
+ */
+struct led_history {
+	struct led_frame ring;
+	uint32_t head; // ring index of module 0
+};
+
+/*
+ * Reset the output to black and set the clock (microseconds, wrapping
+ * around) used to time the submissions and frames.
+ */
+void led_output_init(uint32_t (*clock)(void));
+
+// set the colour of a module in a frame; the values are clamped to 0..1
+void led_frame_set_colour(struct led_frame *frame, uint8_t module,
+		float red, float green, float blue);
+
+// submit the next frame to fade to (copied)
+void led_output_submit(const struct led_frame *frame);
+
+// set all modules of the history to black
+void led_history_reset(struct led_history *history);
+
+// scroll the history by n modules: module i takes the colour of module i-n,
+// modules 0 to n-1 keep their colour
+void led_history_scroll(struct led_history *history, uint32_t n);
+
+// set the colour of a module in the history, see led_frame_set_colour()
+void led_history_set_colour(struct led_history *history, uint8_t module,
+		float red, float green, float blue);
+
+// copy the history to a frame in module order
+void led_history_render(const struct led_history *history, struct led_frame *frame);
+
+// calculate the frame for the current time and send it to the strip; the
+// frame is skipped if the previous one has not been sent yet
+void led_output_render(void);
+
+#endif // LED_OUTPUT_H
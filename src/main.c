@@ -21,31 +21,37 @@
 #include <libopencm3/stm32/rcc.h>
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/timer.h>
-#include <libopencm3/stm32/adc.h>
 #include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/dwt.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
-#include <math.h>
 
 #include "debug.h"
 #include "tictoc.h"
+#include "sched.h"
 #include "ws2801.h"
-#include "MP45DT02.h"
-#include "pdm2pcm.h"
-#include "fifo.h"
+#include "led_output.h"
+#include "audio_source.h"
+#include "musiclight.h"
 #include "fft/fft.h"
-#include "constants.h"
 
-#define FPS 100
+// duration of one audio block (STFT hop) in microseconds
+#define HOP_US ((uint32_t)(1000000ULL * AUDIO_BLOCK_LEN / SAMPLE_RATE))
 
-#define AUDIO_BUFFER_SIZE 48
-#define SAMPLE_BUFFER_SIZE 256
+// time between two LED frames in microseconds
+#define FRAME_US (1000000 / LED_FRAME_RATE)
 
 volatile uint8_t tick_ms = 1;
 
-volatile struct fifo_ctx sample_fifo;
+static uint32_t tick_count = 0;
+
+#if AUDIO_SOURCE == AUDIO_SOURCE_MP45DT02
+static const struct audio_source *const audio = &audio_source_mp45dt02;
+#else
+static const struct audio_source *const audio = &audio_source_adc;
+#endif
 
 
 static void init_gpio(void)
@@ -55,9 +61,6 @@ static void init_gpio(void)
 			GPIO12 | GPIO13 | GPIO14 | GPIO15);
 
 	gpio_set_af(GPIOD, 2, GPIO12 | GPIO13 | GPIO14 | GPIO15);
-
-	// Set up analog input
-	gpio_mode_setup(GPIOA, GPIO_MODE_ANALOG, GPIO_PUPD_NONE, GPIO4);
 }
 
 static void init_clock(void)
@@ -69,7 +72,7 @@ static void init_clock(void)
 	// Port D is needed for LEDs
 	rcc_peripheral_enable_clock(&RCC_AHB1ENR, RCC_AHB1ENR_IOPDEN);
 
-	// Port A is needed for ADC
+	// Port A is needed for USART2
 	rcc_peripheral_enable_clock(&RCC_AHB1ENR, RCC_AHB1ENR_IOPAEN);
 
 	// enable TIM1 clock
@@ -83,20 +86,12 @@ static void init_clock(void)
 
 	// enable TIM4 clock
 	rcc_peripheral_enable_clock(&RCC_APB1ENR, RCC_APB1ENR_TIM4EN);
-
-	// enable TIM3 clock
-	rcc_peripheral_enable_clock(&RCC_APB1ENR, RCC_APB1ENR_TIM3EN);
-
-  // enable ADC1 clock
-	//rcc_peripheral_enable_clock(&RCC_APB2ENR, RCC_APB2ENR_ADC1EN);
-	rcc_periph_clock_enable(RCC_ADC1);
 }
 
 static void init_timer(void)
 {
 	// global interrupt config
 	nvic_enable_irq(NVIC_TIM1_UP_TIM10_IRQ);
-	nvic_enable_irq(NVIC_ADC_IRQ);
 
 	// *** TIM1 ***
 
@@ -149,396 +144,157 @@ static void init_timer(void)
 
 	// GO!
 	timer_enable_counter(TIM4);
-
-	// *** TIM3 ***
-	timer_reset(TIM3);
-	timer_set_mode(TIM3, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
-
-	// prescaler
-	timer_set_prescaler(TIM3, 120); // count up by 1 every 1 us
-
-	// auto-reload value
-	timer_set_period(TIM3, 25); // 40 kHz tick rate
-
-	timer_set_master_mode(TIM3, TIM_CR2_MMS_UPDATE);
-
-	// GO!
-	timer_enable_counter(TIM3);
 }
 
-static void init_adc(void)
+/*
+ * Main loop tasks (see sched.h). The LED frames have the highest priority and
+ * a short deadline, so they go out at a steady rate. Taking the audio blocks
+ * comes next: the queue must not overflow while an effect is busy, so it may
+ * wait for (AUDIO_QUEUE_BLOCKS - 1) blocks. The effect should be done with a
+ * block before the next one arrives, otherwise that block is skipped.
+ */
+static bool frame_task_step(void)
 {
-	uint8_t channel = ADC_CHANNEL4;
-
-	adc_set_multi_mode(ADC_CCR_MULTI_INDEPENDENT);
-
-	adc_power_off(ADC1);
-
-	adc_disable_scan_mode(ADC1);
-	adc_set_single_conversion_mode(ADC1);
-	adc_set_sample_time_on_all_channels(ADC1, ADC_SMPR_SMP_144CYC);
-	adc_set_right_aligned(ADC1);
-	adc_set_regular_sequence(ADC1, 1, &channel);
-
-	adc_enable_external_trigger_regular(ADC1, ADC_CR2_EXTSEL_TIM3_TRGO, ADC_CR2_EXTEN_RISING_EDGE);
-	adc_enable_eoc_interrupt(ADC1);
-
-	adc_power_on(ADC1);
+	led_output_render();
 
-	///* Wait for ADC starting up. */
-	//int i;
-	//for (i = 0; i < 800000; i++) /* Wait a bit. */
-	//	__asm__("nop");
-
-	//adc_reset_calibration(ADC1);
-	//adc_calibration(ADC1);
-	//adc_calibrate(ADC1);
+	return false;
 }
 
-static bool sinusfader(uint32_t tick_count, float *samples)
-{
-	(void)samples; // avoid unused parameter warning
-
-	for(uint8_t i = 0; i < WS2801_NUM_MODULES; i++) {
-		float bphase = 2*PI*((float)i/WS2801_NUM_MODULES + tick_count/5000.0f);
-
-		ws2801_set_colour(i,
-				0.5f + 0.5f * sinf(bphase + 0*PI/4),
-				0.5f + 0.5f * sinf(bphase + 2*PI/3),
-				0.5f + 0.5f * sinf(bphase + 4*PI/3));
-	}
-
-	ws2801_send_update();
+static struct sched_task frame_task = {
+	.name = "frame",
+	.step = frame_task_step,
+	.ready = NULL,
+	.period = FRAME_US,
+	.deadline = FRAME_US / 10,
+	.priority = 3,
+};
 
-	return false;
+static bool audio_task_ready(void)
+{
+	return audio->get_block() != NULL;
 }
 
-static bool musiclight_mono(uint32_t tick_count, float *samples)
+static bool audio_task_step(void)
 {
-	static float v[WS2801_NUM_MODULES];
-
-	static float maxrms = 1e-10;
-
-	float avg = 0;
-	float rms = 0;
-
-	(void)tick_count; // avoid unused parameter warning
-
-	// step 1: calculate average
-	for(uint32_t i = 0; i < SAMPLE_BUFFER_SIZE; i++) {
-		avg += samples[i];
-	}
-
-	avg /= SAMPLE_BUFFER_SIZE;
-
-	// step 2: calculate average
-	for(uint32_t i = 0; i < SAMPLE_BUFFER_SIZE; i++) {
-		float tmp = samples[i] - avg;
-		rms += tmp*tmp;
-	}
-
-	rms /= SAMPLE_BUFFER_SIZE;
-
-	// step 3: shift the value history
-	for(uint8_t i = WS2801_NUM_MODULES-1; i > 0; i--) {
-		v[i] = v[i-1];
-	}
-
-	// step 4: calculate new value
-	maxrms *= 0.999f;
-	if(rms > maxrms) {
-		maxrms = rms;
-	}
-
-	v[0] = rms / maxrms;
-
-	// step 5: assign values to LEDs
-	for(uint8_t i = 0; i < WS2801_NUM_MODULES; i++) {
-		ws2801_set_colour(i, v[i], v[i], v[i]);
-	}
-
-	ws2801_send_update();
+	musiclight_push_block(audio->get_block());
+	audio->release_block();
 
 	return false;
 }
 
-enum MusiclightStep {
-	MS_WINDOW,
-	MS_FFT,
-	MS_FFT_ABS,
-	MS_FFT_DENOISE,
-	MS_EXTRACT_ENERGY,
-	MS_UPDATE_COLORS,
-	MS_APPLY
+static struct sched_task audio_task = {
+	.name = "audio",
+	.step = audio_task_step,
+	.ready = audio_task_ready,
+	.period = HOP_US,
+	.deadline = (AUDIO_QUEUE_BLOCKS - 1) * HOP_US,
+	.priority = 2,
 };
 
-#define MUSICLIGHT_COOLDOWN_FACTOR 0.9998f
-#define MUSICLIGHT_NOISE_COOLDOWN_FACTOR 0.99999f
-#define MUSICLIGHT_HEATUP_FACTOR 1.0002f
-#define MUSICLIGHT_OVERDRIVE 1.0f
-
-//#define COMMONMAX
-
-static bool musiclight(uint32_t tick_count, float *samples)
+static bool effect_task_ready(void)
 {
-	static float r[WS2801_NUM_MODULES];
-	static float g[WS2801_NUM_MODULES];
-	static float b[WS2801_NUM_MODULES];
-
-	static float energy_r = 0;
-	static float energy_g = 0;
-	static float energy_b = 0;
-
-#ifndef COMMONMAX
-	static float max_r = 1e-30f;
-	static float max_g = 1e-30f;
-	static float max_b = 1e-30f;
-#else
-	static float total_energy = 0;
-	static float max_total_energy = 0.001f;
-#endif
-
-	/*
-	static float min_r = 1e30f;
-	static float min_g = 1e30f;
-	static float min_b = 1e30f;
-	*/
-
-	static fft_sample local_samples[FFT_BLOCK_LEN];
-	static fft_value_type fft_re[FFT_BLOCK_LEN];
-	static fft_value_type fft_im[FFT_BLOCK_LEN];
-	static fft_value_type fft_abs[FFT_DATALEN];
-
-	static fft_value_type fft_abs_avg[FFT_DATALEN];
-
-	const fft_value_type fft_avg_alpha = 0.00001f;
+	return musiclight_hop_ready();
+}
 
-	static enum MusiclightStep cur_step = MS_WINDOW;
+static bool effect_task_step(void)
+{
+	return musiclight_process(musiclight, tick_count);
+}
 
-	// reset 1 second after startup
-	if(tick_count <= 1000) {
-		cur_step = MS_WINDOW;
+static struct sched_task effect_task = {
+	.name = "effect",
+	.step = effect_task_step,
+	.ready = effect_task_ready,
+	.period = HOP_US,
+	.deadline = HOP_US,
+	.priority = 1,
+};
 
-		for(uint32_t i = 0; i < FFT_DATALEN; i++) {
-			fft_abs_avg[i] = 0.0f;
-		}
+// print the cycles per bin of all magnitude modes (see config.h) on startup
+//#define MAGNITUDE_BENCHMARK
 
-#ifndef COMMONMAX
-		max_r = 1e-30f;
-		max_g = 1e-30f;
-		max_b = 1e-30f;
-#else
-		total_energy = 0;
-		max_total_energy = 0.001f;
-#endif
+#ifdef MAGNITUDE_BENCHMARK
+#define MAGNITUDE_BENCHMARK_RUNS 100
 
-		for(uint8_t i = 0; i < WS2801_NUM_MODULES; i++) {
-			ws2801_set_colour(i, 0, 0, 0);
-		}
+static void magnitude_benchmark_run(char *name,
+		void (*func)(fft_value_type *re, fft_value_type *im, fft_value_type *result))
+{
+	static fft_value_type re[FFT_DATALEN];
+	static fft_value_type im[FFT_DATALEN];
+	static fft_value_type result[FFT_DATALEN];
 
-		ws2801_send_update();
+	char buf[64];
 
-		return false;
+	for(uint32_t i = 0; i < FFT_DATALEN; i++) {
+		re[i] = 0.01f * i;
+		im[i] = 1.0f - 0.02f * i;
 	}
 
-	switch(cur_step) {
-		case MS_WINDOW:
-			fft_copy_windowed(samples, local_samples);
-			cur_step = MS_FFT;
-			return true;
-			break;
-
-		case MS_FFT:
-			fft_transform(samples, fft_re, fft_im);
-			cur_step = MS_FFT_ABS;
-			return true;
-			break;
-
-		case MS_FFT_ABS:
-			fft_complex_to_absolute(fft_re, fft_im, fft_abs);
-			cur_step = MS_FFT_DENOISE;
-			return true;
-			break;
-
-		case MS_FFT_DENOISE:
-			// calculate a long-term average for the power in each FFT bin using an
-			// exponential averaging filter. This should mostly contain the noise
-			// power, as the signal will probably vary over time.
-			for(int i = 0; i < FFT_DATALEN; i++) {
-				//fft_abs_avg[i] *= MUSICLIGHT_NOISE_COOLDOWN_FACTOR;
-				//if(fft_abs[i] > fft_abs_avg[i]) {
-					fft_abs_avg[i] = fft_avg_alpha * fft_abs[i] + (1 - fft_avg_alpha) * fft_abs_avg[i];
-				//}
-
-				fft_abs[i] -= fft_abs_avg[i];
-				if(fft_abs[i] < 0) {
-					fft_abs[i] = 0;
-				}
-			}
-
-			cur_step = MS_EXTRACT_ENERGY;
-			return true;
-			break;
-
-		case MS_EXTRACT_ENERGY:
-#ifdef COMMONMAX
-			energy_r = fft_get_energy_in_band(fft_abs, 80, 400) / 400;
-			energy_g = fft_get_energy_in_band(fft_abs, 400, 4000) / 3600;
-			energy_b = fft_get_energy_in_band(fft_abs, 4000, 10000) / 6000;
-#else
-			// ignore feedback frequency from the LED stripe (2,5 kHz) and overtones
-			energy_r  = fft_get_energy_in_band(fft_abs, 0, 400);
-			energy_g  = fft_get_energy_in_band(fft_abs, 400, 2450);
-			energy_g += fft_get_energy_in_band(fft_abs, 2550, 4000);
-			energy_b  = fft_get_energy_in_band(fft_abs, 4000, 4935);
-			energy_b += fft_get_energy_in_band(fft_abs, 5065, 7420);
-			energy_b += fft_get_energy_in_band(fft_abs, 7580, 9900);
-#endif
-
-#ifdef COMMONMAX
-			total_energy = energy_r + energy_g + energy_b;
-#endif
+	uint32_t start = dwt_read_cycle_counter();
 
-			cur_step = MS_UPDATE_COLORS;
-			return true;
-			break;
-
-		case MS_UPDATE_COLORS:
-#ifndef COMMONMAX
-			max_r *= MUSICLIGHT_COOLDOWN_FACTOR;
-			max_g *= MUSICLIGHT_COOLDOWN_FACTOR;
-			max_b *= MUSICLIGHT_COOLDOWN_FACTOR;
-
-			if(energy_r > max_r) { max_r = energy_r; }
-			if(energy_g > max_g) { max_g = energy_g; }
-			if(energy_b > max_b) { max_b = energy_b; }
-#else
-			max_total_energy *= MUSICLIGHT_COOLDOWN_FACTOR;
-
-			if(total_energy > max_total_energy) { max_total_energy = total_energy; }
-#endif
-
-			/*
-			min_r *= MUSICLIGHT_HEATUP_FACTOR;
-			min_g *= MUSICLIGHT_HEATUP_FACTOR;
-			min_b *= MUSICLIGHT_HEATUP_FACTOR;
-
-			if(energy_r < min_r) { min_r = energy_r; }
-			if(energy_g < min_g) { min_g = energy_g; }
-			if(energy_b < min_b) { min_b = energy_b; }
-			*/
-
-			for(uint8_t i = WS2801_NUM_MODULES-1; i > 1; i-=2) {
-				r[i] = r[i-2];
-				g[i] = g[i-2];
-				b[i] = b[i-2];
-				r[i-1] = r[i-3];
-				g[i-1] = g[i-3];
-				b[i-1] = b[i-3];
-			}
-
-#ifndef COMMONMAX
-			//r[0] = (energy_r - min_r) / (max_r - min_r);
-			//g[0] = (energy_g - min_g) / (max_g - min_g);
-			//b[0] = (energy_b - min_b) / (max_b - min_b);
-			r[1] = r[0] = energy_r / max_r;
-			g[1] = g[0] = energy_g / max_g;
-			b[1] = b[0] = energy_b / max_b;
-#else
-			r[0] = MUSICLIGHT_OVERDRIVE * energy_r / max_total_energy;
-			g[0] = MUSICLIGHT_OVERDRIVE * energy_g / max_total_energy;
-			b[0] = MUSICLIGHT_OVERDRIVE * energy_b / max_total_energy;
+	for(uint32_t i = 0; i < MAGNITUDE_BENCHMARK_RUNS; i++) {
+		func(re, im, result);
+	}
 
-			if(r[0] > 1.0f) { r[0] = 1.0f; };
-			if(g[0] > 1.0f) { g[0] = 1.0f; };
-			if(b[0] > 1.0f) { b[0] = 1.0f; };
-#endif
+	uint32_t cycles = dwt_read_cycle_counter() - start;
 
-			cur_step = MS_APPLY;
-			return true;
-			break;
+	// cycles per bin with two decimals
+	uint32_t centi = cycles * 100 / (MAGNITUDE_BENCHMARK_RUNS * FFT_DATALEN);
 
-		case MS_APPLY:
-			for(uint8_t i = 0; i < WS2801_NUM_MODULES; i++) {
-				ws2801_set_colour(i, r[i], g[i], b[i]);
-			}
+	snprintf(buf, sizeof(buf), "%s: %lu.%02lu cycles/bin\r\n", name,
+			(unsigned long)(centi / 100), (unsigned long)(centi % 100));
+	debug_send_string(buf);
+}
 
-			ws2801_send_update();
+static void magnitude_benchmark(void)
+{
+	dwt_enable_cycle_counter();
 
-			cur_step = MS_WINDOW;
-			return false;
-			break;
+	audio->stop();
 
-	};
+	magnitude_benchmark_run("sqrt", fft_complex_to_absolute);
+	magnitude_benchmark_run("power", fft_complex_to_power);
+	magnitude_benchmark_run("approx", fft_complex_to_absolute_approx);
 
-	return false;
+	audio->start();
 }
+#endif
 
 int main(void)
 {
-	uint32_t tick_count = 0;
-
-	//uint32_t mic_buf0[AUDIO_BUFFER_SIZE], mic_buf1[AUDIO_BUFFER_SIZE];
-	//uint32_t *cur_mic_buf = mic_buf0;
-	//uint32_t *old_mic_buf = 0;
-
-	float sample_buffer[SAMPLE_BUFFER_SIZE];
-
-	bool must_update = false;
-
 	init_clock();
 	init_gpio();
-	init_adc();
 	init_timer();
 
+	// before the audio source, which reports configuration errors
 	debug_init();
+	audio->init();
+
 	tictoc_init();
 
-	fifo_init(&sample_fifo);
+	led_output_init(tictoc_now);
+	musiclight_init();
 
 	ws2801_init();
 	ws2801_setup_dma();
 
-	fft_init();
-
 	debug_send_string("Init complete\r\n");
 
-	timer_set_oc_value(TIM4, TIM_OC1, 100);
-
-	while (1) {
-		/*
-		cur_mic_buf = mp45dt02_dma_get_current_buffer() ? mic_buf0 : mic_buf1;
-
-		if( old_mic_buf != cur_mic_buf){
-			pdm2pcm_decode_to_fifo(&pdmctx, cur_mic_buf, AUDIO_BUFFER_SIZE, &sample_fifo);
-
-			if(fifo_get_level(&sample_fifo) >= SAMPLE_BUFFER_SIZE) {
-				for(uint32_t i = 0; i < SAMPLE_BUFFER_SIZE; i++) {
-					sample_buffer[i] = fifo_pop(&sample_fifo) / (float)(1 << 30);
-				}
+	audio->start();
 
-				// new samples arrived
-				must_update = true;
-			}
-
-			old_mic_buf = cur_mic_buf;
-		}
-		*/
+#ifdef MAGNITUDE_BENCHMARK
+	magnitude_benchmark();
+#endif
 
-		if(fifo_get_level(&sample_fifo) >= SAMPLE_BUFFER_SIZE) {
-			for(uint32_t i = 0; i < SAMPLE_BUFFER_SIZE; i++) {
-				nvic_disable_irq(NVIC_ADC_IRQ); // start critical section
-				sample_buffer[i] = fifo_pop(&sample_fifo) / (float)(1 << 12);
-				nvic_enable_irq(NVIC_ADC_IRQ); // end critical section
-			}
+	timer_set_oc_value(TIM4, TIM_OC1, 100);
 
-			// new samples arrived
-			must_update = true;
-		}
+	sched_init(tictoc_now);
+	sched_add(&frame_task);
+	sched_add(&audio_task);
+	sched_add(&effect_task);
 
-		if(must_update) {
-			must_update = musiclight(tick_count, sample_buffer);
-		}
+	while (1) {
+		sched_run();
 
 		if(tick_ms == 1) {
 			tick_ms = 0;
@@ -559,24 +315,6 @@ void tim1_up_tim10_isr(void)
 	}
 }
 
-#define ADC_LOWPASS_EXPONENT 18
-
-void adc_isr(void)
-{
-	static uint32_t adcavg = 2048;
-
-	uint16_t adcval;
-
-	if(adc_eoc(ADC1)) { //ADC1_SR & ADC_SR_EOC) {
-		adcval = adc_read_regular(ADC1);
-
-		adcavg = (adcavg - (adcavg >> ADC_LOWPASS_EXPONENT)) + adcval;
-
-		fifo_push(&sample_fifo, (fifo_t)adcval - (adcavg >> ADC_LOWPASS_EXPONENT));
-		//timer_set_oc_value(TIM4, TIM_OC2, adcval >> 2);
-	}
-}
-
 void hard_fault_handler(void)
 {
 	while(1);
@@ -0,0 +1,699 @@
+/*
+ * The light effects and the analysis pipeline feeding them. Independent of
+ * the hardware except for the LED output (see led_output.c and
+ * ws2801_message.c), so the same code runs in the firmware and in the host
+ * replay tool (host/replay.c).
+ */
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "musiclight.h"
+#include "ws2801.h"
+#include "led_output.h"
+#include "fft/fft.h"
+#include "fft/fft_q15.h"
+#include "fft/stft.h"
+#include "fft/sdft.h"
+#include "fft/filterbank.h"
+#include "fft/decimator.h"
+#include "constants.h"
+
+// number of spectrum updates per FFT block
+#define STFT_HOPS_PER_BLOCK (FFT_BLOCK_LEN / STFT_HOP_SIZE)
+
+#ifdef MUSICLIGHT_SDFT
+#ifdef FFT_FIXED_POINT
+#error "MUSICLIGHT_SDFT requires the float pipeline"
+#endif
+
+static struct sdft_ctx musiclight_sdft;
+#endif
+
+static struct stft_ctx musiclight_stft;
+
+#ifdef MUSICLIGHT_MULTIRATE
+#ifdef MUSICLIGHT_SDFT
+#error "MUSICLIGHT_MULTIRATE requires the block FFT"
+#endif
+
+// the low bands are analysed in a block of the decimated signal, which is
+// complete every DECIMATOR_FACTOR hops
+static struct decimator_ctx musiclight_decimator;
+static struct stft_ctx musiclight_low_stft;
+static fft_sample *musiclight_low_block = NULL;
+#endif
+
+// means of the last audio blocks (one per hop, see audio_source.h)
+static float musiclight_hop_means[STFT_HOPS_PER_BLOCK];
+static uint32_t musiclight_hop_idx = 0;
+
+// the block being processed by the current effect and its mean
+static fft_sample *musiclight_block = NULL;
+static float musiclight_block_mean = 0;
+static bool musiclight_busy = false;
+
+// the next frame of the current effect (see led_output.h)
+static struct led_frame musiclight_frame;
+
+#if AUDIO_BLOCK_LEN != STFT_HOP_SIZE
+#error "the block means are collected per hop"
+#endif
+
+bool sinusfader(uint32_t tick_count, fft_sample *samples)
+{
+	(void)samples; // avoid unused parameter warning
+
+	for(uint8_t i = 0; i < WS2801_NUM_MODULES; i++) {
+		float bphase = 2*PI*((float)i/WS2801_NUM_MODULES + tick_count/5000.0f);
+
+		led_frame_set_colour(&musiclight_frame, i,
+				0.5f + 0.5f * sinf(bphase + 0*PI/4),
+				0.5f + 0.5f * sinf(bphase + 2*PI/3),
+				0.5f + 0.5f * sinf(bphase + 4*PI/3));
+	}
+
+	led_output_submit(&musiclight_frame);
+
+	return false;
+}
+
+bool musiclight_mono(uint32_t tick_count, fft_sample *samples)
+{
+	static struct led_history history;
+
+	static float maxrms = 1e-10;
+
+	// step 1: the average is known from the audio source
+	float avg = musiclight_block_mean;
+	float rms = 0;
+
+	(void)tick_count; // avoid unused parameter warning
+
+	// step 2: calculate average
+	for(uint32_t i = 0; i < FFT_BLOCK_LEN; i++) {
+		float tmp = samples[i] - avg;
+		rms += tmp*tmp;
+	}
+
+	rms /= FFT_BLOCK_LEN;
+
+	// step 3: scroll the value history
+	led_history_scroll(&history, 1);
+
+	// step 4: calculate new value
+	maxrms *= 0.999f;
+	if(rms > maxrms) {
+		maxrms = rms;
+	}
+
+	float v = rms / maxrms;
+	led_history_set_colour(&history, 0, v, v, v);
+
+	// step 5: assign values to LEDs
+	led_history_render(&history, &musiclight_frame);
+	led_output_submit(&musiclight_frame);
+
+	return false;
+}
+
+// the factors are given per FFT block, but applied once per STFT hop
+#define MUSICLIGHT_COOLDOWN_FACTOR 0.9998f
+#define MUSICLIGHT_NOISE_COOLDOWN_FACTOR 0.99999f
+#define MUSICLIGHT_HEATUP_FACTOR 1.0002f
+#define MUSICLIGHT_OVERDRIVE 1.0f
+
+// MUSICLIGHT_COOLDOWN_FACTOR converted to a factor per STFT hop, calculated
+// once in musiclight_init()
+static float musiclight_cooldown_per_hop;
+
+// averaging time constant of the fixed-point noise estimation (2^-17 per
+// block is close to fft_avg_alpha)
+#define MUSICLIGHT_NOISE_AVG_EXPONENT (17 + FFT_EXPONENT - STFT_HOP_EXPONENT)
+
+// averaging factor of the float noise estimation per hop
+#define MUSICLIGHT_NOISE_AVG_ALPHA (0.00001f / STFT_HOPS_PER_BLOCK)
+
+//#define COMMONMAX
+
+// outputs of the filterbank
+#define MUSICLIGHT_RED   0
+#define MUSICLIGHT_GREEN 1
+#define MUSICLIGHT_BLUE  2
+#define MUSICLIGHT_NUM_OUTPUTS 3
+
+static const struct filterbank_band musiclight_bands[] = {
+#ifdef COMMONMAX
+#ifndef MUSICLIGHT_MULTIRATE
+	{  80,   400, FILTERBANK_RECT, MUSICLIGHT_RED,   1.0f / 400},
+#endif
+	{ 400,  4000, FILTERBANK_RECT, MUSICLIGHT_GREEN, 1.0f / 3600},
+	{4000, 10000, FILTERBANK_RECT, MUSICLIGHT_BLUE,  1.0f / 6000},
+#else
+	// ignore feedback frequency from the LED stripe (2,5 kHz) and overtones
+#ifndef MUSICLIGHT_MULTIRATE
+	{   0,   400, FILTERBANK_RECT, MUSICLIGHT_RED,   1.0f},
+#endif
+	{ 400,  2450, FILTERBANK_RECT, MUSICLIGHT_GREEN, 1.0f},
+	{2550,  4000, FILTERBANK_RECT, MUSICLIGHT_GREEN, 1.0f},
+	{4000,  4935, FILTERBANK_RECT, MUSICLIGHT_BLUE,  1.0f},
+	{5065,  7420, FILTERBANK_RECT, MUSICLIGHT_BLUE,  1.0f},
+	{7580,  9900, FILTERBANK_RECT, MUSICLIGHT_BLUE,  1.0f},
+#endif
+};
+
+#ifdef MUSICLIGHT_MULTIRATE
+// bands taken from the spectrum of the decimated signal instead
+static const struct filterbank_band musiclight_low_bands[] = {
+#ifdef COMMONMAX
+	{  80,   400, FILTERBANK_RECT, MUSICLIGHT_RED,   1.0f / 400},
+#else
+	{   0,   400, FILTERBANK_RECT, MUSICLIGHT_RED,   1.0f},
+#endif
+};
+#endif
+
+/*
+ * Working set of one spectrum analysis: FFT of a block, magnitudes, noise
+ * removal and band energies.
+ */
+struct musiclight_spectrum {
+#ifdef FFT_FIXED_POINT
+	// windowed samples, loaded directly from the STFT block (see
+	// fft_q15_load_windowed())
+	uint32_t fft_cplx[FFT_DATALEN];
+	uint32_t fft_bits;
+	int fft_exponent;
+	uint32_t fft_abs[FFT_DATALEN];
+
+	// noise average, scaled by 2^noise_avg_exponent
+	uint64_t fft_abs_avg[FFT_DATALEN];
+	uint32_t noise_avg_exponent;
+#else
+	// windowed samples, transformed in place to the packed spectrum (see fft.h)
+	fft_value_type fft_buf[FFT_BLOCK_LEN];
+	fft_value_type fft_abs[FFT_DATALEN];
+
+	fft_value_type fft_abs_avg[FFT_DATALEN];
+	fft_value_type fft_avg_alpha;
+#endif
+
+	struct filterbank filterbank;
+	filterbank_value energy[MUSICLIGHT_NUM_OUTPUTS];
+};
+
+// the FFT working sets are only accessed by the CPU and live in the CCM
+static struct musiclight_spectrum musiclight_full CCMRAM;
+
+#ifdef MUSICLIGHT_MULTIRATE
+static struct musiclight_spectrum musiclight_low CCMRAM;
+#endif
+
+/*
+ * Set up a spectrum analysis whose blocks have the given sample rate and are
+ * transformed every hops_per_update STFT hops (of the full rate signal).
+ */
+static void spectrum_init(struct musiclight_spectrum *spec, const struct filterbank_band *bands,
+		uint32_t num_bands, uint32_t sample_rate, uint32_t hops_per_update)
+{
+#ifdef FFT_FIXED_POINT
+	uint32_t exponent = MUSICLIGHT_NOISE_AVG_EXPONENT;
+
+	// the same time constant with fewer updates
+	while(hops_per_update > 1) {
+		hops_per_update /= 2;
+		exponent--;
+	}
+
+	spec->noise_avg_exponent = exponent;
+#else
+	spec->fft_avg_alpha = MUSICLIGHT_NOISE_AVG_ALPHA * hops_per_update;
+#endif
+
+	filterbank_init_rate(&spec->filterbank, bands, num_bands, sample_rate);
+}
+
+static void spectrum_reset(struct musiclight_spectrum *spec)
+{
+	for(uint32_t i = 0; i < FFT_DATALEN; i++) {
+		spec->fft_abs_avg[i] = 0;
+	}
+
+	for(uint32_t i = 0; i < MUSICLIGHT_NUM_OUTPUTS; i++) {
+		spec->energy[i] = 0;
+	}
+}
+
+#ifndef MUSICLIGHT_SDFT
+static void spectrum_window(struct musiclight_spectrum *spec, fft_sample *samples)
+{
+#ifdef FFT_FIXED_POINT
+	spec->fft_bits = fft_q15_load_windowed(samples, spec->fft_cplx);
+#else
+	fft_copy_windowed(samples, spec->fft_buf);
+#endif
+}
+
+static void spectrum_fft(struct musiclight_spectrum *spec)
+{
+#ifdef FFT_FIXED_POINT
+	spec->fft_exponent = fft_q15_transform_loaded(spec->fft_cplx, spec->fft_bits);
+#else
+	fft_transform_real_inplace(spec->fft_buf);
+#endif
+}
+
+static void spectrum_abs(struct musiclight_spectrum *spec)
+{
+#ifdef FFT_FIXED_POINT
+	fft_q15_complex_to_absolute(spec->fft_cplx, spec->fft_exponent, spec->fft_abs);
+#elif FFT_MAGNITUDE == FFT_MAGNITUDE_POWER
+	fft_packed_to_power(spec->fft_buf, spec->fft_abs);
+#elif FFT_MAGNITUDE == FFT_MAGNITUDE_APPROX
+	fft_packed_to_absolute_approx(spec->fft_buf, spec->fft_abs);
+#else
+	fft_packed_to_absolute(spec->fft_buf, spec->fft_abs);
+#endif
+}
+#endif
+
+static void spectrum_denoise(struct musiclight_spectrum *spec)
+{
+#ifdef FFT_FIXED_POINT
+	uint64_t *fft_abs_avg = spec->fft_abs_avg;
+	uint32_t *fft_abs = spec->fft_abs;
+	const uint32_t exponent = spec->noise_avg_exponent;
+
+	// same as below, but with a running sum
+	for(int i = 0; i < FFT_DATALEN; i++) {
+		fft_abs_avg[i] = fft_abs_avg[i] - (fft_abs_avg[i] >> exponent) + fft_abs[i];
+
+		uint32_t noise = fft_abs_avg[i] >> exponent;
+		if(fft_abs[i] > noise) {
+			fft_abs[i] -= noise;
+		} else {
+			fft_abs[i] = 0;
+		}
+	}
+#else
+	fft_value_type *fft_abs_avg = spec->fft_abs_avg;
+	fft_value_type *fft_abs = spec->fft_abs;
+	const fft_value_type fft_avg_alpha = spec->fft_avg_alpha;
+
+	// calculate a long-term average for the power in each FFT bin using an
+	// exponential averaging filter. This should mostly contain the noise
+	// power, as the signal will probably vary over time.
+	for(int i = 0; i < FFT_DATALEN; i++) {
+		//fft_abs_avg[i] *= MUSICLIGHT_NOISE_COOLDOWN_FACTOR;
+		//if(fft_abs[i] > fft_abs_avg[i]) {
+			fft_abs_avg[i] = fft_avg_alpha * fft_abs[i] + (1 - fft_avg_alpha) * fft_abs_avg[i];
+		//}
+
+		fft_abs[i] -= fft_abs_avg[i];
+		if(fft_abs[i] < 0) {
+			fft_abs[i] = 0;
+		}
+	}
+#endif
+}
+
+static void spectrum_extract_energy(struct musiclight_spectrum *spec)
+{
+	filterbank_apply(&spec->filterbank, spec->fft_abs, spec->energy);
+}
+
+/*
+ * State of the musiclight() effect, shared by its stages.
+ */
+struct musiclight_colors {
+	// LED values, scrolling along the strip
+	struct led_history history;
+
+	float energy_r;
+	float energy_g;
+	float energy_b;
+
+#ifndef COMMONMAX
+	float max_r;
+	float max_g;
+	float max_b;
+#else
+	float total_energy;
+	float max_total_energy;
+#endif
+
+	/*
+	float min_r;
+	float min_g;
+	float min_b;
+	*/
+
+	// the LED history is scrolled once per block, so it moves at the same speed
+	// regardless of the hop size
+	uint32_t hop_count;
+};
+
+static struct musiclight_colors musiclight_colors;
+
+static void musiclight_colors_reset(struct musiclight_colors *c)
+{
+	c->energy_r = 0;
+	c->energy_g = 0;
+	c->energy_b = 0;
+
+#ifndef COMMONMAX
+	c->max_r = 1e-30f;
+	c->max_g = 1e-30f;
+	c->max_b = 1e-30f;
+#else
+	c->total_energy = 0;
+	c->max_total_energy = 0.001f;
+#endif
+
+	c->hop_count = 0;
+
+	led_history_reset(&c->history);
+}
+
+/*
+ * The stages of musiclight(), one per call. Each one is short, so other work
+ * (e.g. taking the next audio block) can be scheduled in between, and the
+ * scheduler can measure them separately (see sched.h).
+ */
+typedef void (*musiclight_stage)(fft_sample *samples);
+
+#ifdef MUSICLIGHT_SDFT
+static void stage_sdft(fft_sample *samples)
+{
+	// the sliding DFT is always up to date, just read the magnitudes of the
+	// bins up to SDFT_MAX_FREQ (the rest of fft_abs stays 0)
+	(void)samples;
+	sdft_get_absolute(&musiclight_sdft, musiclight_full.fft_abs);
+}
+#else
+static void stage_window(fft_sample *samples)
+{
+#ifdef MUSICLIGHT_MULTIRATE
+	// the block of the decimated signal is overwritten by the next audio block
+	// as well
+	if(musiclight_low_block) {
+		spectrum_window(&musiclight_low, musiclight_low_block);
+	}
+#endif
+	spectrum_window(&musiclight_full, samples);
+}
+
+static void stage_fft(fft_sample *samples)
+{
+	(void)samples;
+	spectrum_fft(&musiclight_full);
+}
+
+static void stage_abs(fft_sample *samples)
+{
+	(void)samples;
+	spectrum_abs(&musiclight_full);
+}
+#endif
+
+static void stage_denoise(fft_sample *samples)
+{
+	(void)samples;
+	spectrum_denoise(&musiclight_full);
+}
+
+static void stage_extract_energy(fft_sample *samples)
+{
+	(void)samples;
+	spectrum_extract_energy(&musiclight_full);
+}
+
+#ifdef MUSICLIGHT_MULTIRATE
+// the low bands are updated every DECIMATOR_FACTOR hops and keep their energy
+// in between; the stages do nothing in the other hops, so the stage indices
+// (and their measured times) stay the same
+static void stage_low_fft(fft_sample *samples)
+{
+	(void)samples;
+	if(musiclight_low_block) {
+		spectrum_fft(&musiclight_low);
+	}
+}
+
+static void stage_low_abs(fft_sample *samples)
+{
+	(void)samples;
+	if(musiclight_low_block) {
+		spectrum_abs(&musiclight_low);
+	}
+}
+
+static void stage_low_denoise(fft_sample *samples)
+{
+	(void)samples;
+	if(musiclight_low_block) {
+		spectrum_denoise(&musiclight_low);
+	}
+}
+
+static void stage_low_extract_energy(fft_sample *samples)
+{
+	(void)samples;
+	if(musiclight_low_block) {
+		spectrum_extract_energy(&musiclight_low);
+	}
+}
+#endif
+
+static void stage_update_colors(fft_sample *samples)
+{
+	struct musiclight_colors *c = &musiclight_colors;
+
+	(void)samples;
+
+	// merge the bands of both spectra
+	c->energy_r = musiclight_full.energy[MUSICLIGHT_RED];
+	c->energy_g = musiclight_full.energy[MUSICLIGHT_GREEN];
+	c->energy_b = musiclight_full.energy[MUSICLIGHT_BLUE];
+
+#ifdef MUSICLIGHT_MULTIRATE
+	c->energy_r += musiclight_low.energy[MUSICLIGHT_RED];
+	c->energy_g += musiclight_low.energy[MUSICLIGHT_GREEN];
+	c->energy_b += musiclight_low.energy[MUSICLIGHT_BLUE];
+#endif
+
+#ifdef COMMONMAX
+	c->total_energy = c->energy_r + c->energy_g + c->energy_b;
+#endif
+
+#ifndef COMMONMAX
+	c->max_r *= musiclight_cooldown_per_hop;
+	c->max_g *= musiclight_cooldown_per_hop;
+	c->max_b *= musiclight_cooldown_per_hop;
+
+	if(c->energy_r > c->max_r) { c->max_r = c->energy_r; }
+	if(c->energy_g > c->max_g) { c->max_g = c->energy_g; }
+	if(c->energy_b > c->max_b) { c->max_b = c->energy_b; }
+#else
+	c->max_total_energy *= musiclight_cooldown_per_hop;
+
+	if(c->total_energy > c->max_total_energy) { c->max_total_energy = c->total_energy; }
+#endif
+
+	/*
+	c->min_r *= MUSICLIGHT_HEATUP_FACTOR;
+	c->min_g *= MUSICLIGHT_HEATUP_FACTOR;
+	c->min_b *= MUSICLIGHT_HEATUP_FACTOR;
+
+	if(c->energy_r < c->min_r) { c->min_r = c->energy_r; }
+	if(c->energy_g < c->min_g) { c->min_g = c->energy_g; }
+	if(c->energy_b < c->min_b) { c->min_b = c->energy_b; }
+	*/
+
+	c->hop_count++;
+	if(c->hop_count == STFT_HOPS_PER_BLOCK) {
+		c->hop_count = 0;
+
+		// two modules per block
+		led_history_scroll(&c->history, 2);
+	}
+
+#ifndef COMMONMAX
+	//r = (c->energy_r - c->min_r) / (c->max_r - c->min_r);
+	//g = (c->energy_g - c->min_g) / (c->max_g - c->min_g);
+	//b = (c->energy_b - c->min_b) / (c->max_b - c->min_b);
+	float r = c->energy_r / c->max_r;
+	float g = c->energy_g / c->max_g;
+	float b = c->energy_b / c->max_b;
+
+	led_history_set_colour(&c->history, 0, r, g, b);
+	led_history_set_colour(&c->history, 1, r, g, b);
+#else
+	// clamped to 1 by led_history_set_colour()
+	led_history_set_colour(&c->history, 0,
+			MUSICLIGHT_OVERDRIVE * c->energy_r / c->max_total_energy,
+			MUSICLIGHT_OVERDRIVE * c->energy_g / c->max_total_energy,
+			MUSICLIGHT_OVERDRIVE * c->energy_b / c->max_total_energy);
+#endif
+}
+
+static void stage_apply(fft_sample *samples)
+{
+	struct musiclight_colors *c = &musiclight_colors;
+
+	(void)samples;
+
+	led_history_render(&c->history, &musiclight_frame);
+	led_output_submit(&musiclight_frame);
+}
+
+static const musiclight_stage musiclight_stages[] = {
+#ifdef MUSICLIGHT_SDFT
+	stage_sdft,
+#else
+	stage_window,
+	stage_fft,
+	stage_abs,
+#endif
+	stage_denoise,
+	stage_extract_energy,
+#ifdef MUSICLIGHT_MULTIRATE
+	stage_low_fft,
+	stage_low_abs,
+	stage_low_denoise,
+	stage_low_extract_energy,
+#endif
+	stage_update_colors,
+	stage_apply,
+};
+
+#define MUSICLIGHT_NUM_STAGES (sizeof(musiclight_stages) / sizeof(musiclight_stages[0]))
+
+bool musiclight(uint32_t tick_count, fft_sample *samples)
+{
+	static uint32_t stage = 0;
+
+	// reset 1 second after startup
+	if(tick_count <= 1000) {
+		stage = 0;
+		musiclight_colors_reset(&musiclight_colors);
+
+		spectrum_reset(&musiclight_full);
+#ifdef MUSICLIGHT_MULTIRATE
+		spectrum_reset(&musiclight_low);
+#endif
+
+		for(uint8_t i = 0; i < WS2801_NUM_MODULES; i++) {
+			led_frame_set_colour(&musiclight_frame, i, 0, 0, 0);
+		}
+
+		led_output_submit(&musiclight_frame);
+
+		return false;
+	}
+
+	musiclight_stages[stage](samples);
+
+	stage++;
+	if(stage == MUSICLIGHT_NUM_STAGES) {
+		stage = 0;
+		return false;
+	}
+
+	return true;
+}
+
+void musiclight_init(void)
+{
+	stft_init(&musiclight_stft);
+#ifdef MUSICLIGHT_SDFT
+	sdft_init(&musiclight_sdft);
+#endif
+
+	spectrum_init(&musiclight_full, musiclight_bands,
+			sizeof(musiclight_bands) / sizeof(musiclight_bands[0]), SAMPLE_RATE, 1);
+	spectrum_reset(&musiclight_full);
+
+#ifdef MUSICLIGHT_MULTIRATE
+	decimator_init(&musiclight_decimator);
+	stft_init(&musiclight_low_stft);
+
+	spectrum_init(&musiclight_low, musiclight_low_bands,
+			sizeof(musiclight_low_bands) / sizeof(musiclight_low_bands[0]),
+			DECIMATOR_SAMPLE_RATE, DECIMATOR_FACTOR);
+	spectrum_reset(&musiclight_low);
+
+	musiclight_low_block = NULL;
+#endif
+
+	for(uint32_t i = 0; i < STFT_HOPS_PER_BLOCK; i++) {
+		musiclight_hop_means[i] = 0;
+	}
+	musiclight_hop_idx = 0;
+
+	musiclight_block = NULL;
+	musiclight_block_mean = 0;
+	musiclight_busy = false;
+
+	musiclight_cooldown_per_hop = powf(MUSICLIGHT_COOLDOWN_FACTOR, 1.0f / STFT_HOPS_PER_BLOCK);
+}
+
+void musiclight_push_block(const struct audio_block *block)
+{
+	for(uint32_t i = 0; i < AUDIO_BLOCK_LEN; i++) {
+		stft_push(&musiclight_stft, block->samples[i]);
+#ifdef MUSICLIGHT_SDFT
+		sdft_update(&musiclight_sdft, block->samples[i]);
+#endif
+	}
+
+#ifdef MUSICLIGHT_MULTIRATE
+	fft_sample decimated[AUDIO_BLOCK_LEN / DECIMATOR_FACTOR + 1];
+	uint32_t n = decimator_process(&musiclight_decimator, block->samples, AUDIO_BLOCK_LEN, decimated);
+
+	for(uint32_t i = 0; i < n; i++) {
+		stft_push(&musiclight_low_stft, decimated[i]);
+	}
+#endif
+
+	musiclight_hop_means[musiclight_hop_idx] = block->mean;
+	musiclight_hop_idx = (musiclight_hop_idx + 1) % STFT_HOPS_PER_BLOCK;
+}
+
+bool musiclight_hop_ready(void)
+{
+	return stft_hop_ready(&musiclight_stft);
+}
+
+bool musiclight_process(musiclight_effect effect, uint32_t tick_count)
+{
+	// start a new update with the latest block only if the previous one is
+	// complete, as the block is overwritten by further samples
+	if(!musiclight_busy && stft_hop_ready(&musiclight_stft)) {
+		musiclight_block = stft_get_block(&musiclight_stft);
+
+#ifdef MUSICLIGHT_MULTIRATE
+		musiclight_low_block = NULL;
+		if(stft_hop_ready(&musiclight_low_stft)) {
+			musiclight_low_block = stft_get_block(&musiclight_low_stft);
+		}
+#endif
+
+		// the FFT block consists of the last STFT_HOPS_PER_BLOCK audio blocks
+		float sum = 0;
+		for(uint32_t i = 0; i < STFT_HOPS_PER_BLOCK; i++) {
+			sum += musiclight_hop_means[i];
+		}
+		musiclight_block_mean = sum * (1.0f / STFT_HOPS_PER_BLOCK);
+
+		// new samples arrived
+		musiclight_busy = true;
+	}
+
+	if(musiclight_busy) {
+		musiclight_busy = effect(tick_count, musiclight_block);
+	}
+
+	return musiclight_busy;
+}
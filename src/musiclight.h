@@ -0,0 +1,43 @@
+#ifndef MUSICLIGHT_H
+#define MUSICLIGHT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "config.h"
+#include "audio_source.h"
+
+/*
+ * A light effect: called with the latest FFT_BLOCK_LEN samples (oldest first)
+ * and the time in milliseconds. Returns true as long as it needs to be called
+ * again for the same block (the work is split into short steps, which are
+ * scheduled separately, see sched.h), false when the next frame has been
+ * submitted to the LED output (see led_output.h).
+ */
+typedef bool (*musiclight_effect)(uint32_t tick_count, fft_sample *samples);
+
+// spectrum analysis with three bands (red/green/blue) scrolling along the strip
+bool musiclight(uint32_t tick_count, fft_sample *samples);
+
+// loudness (RMS) scrolling along the strip
+bool musiclight_mono(uint32_t tick_count, fft_sample *samples);
+
+// colour waves, ignoring the audio input
+bool sinusfader(uint32_t tick_count, fft_sample *samples);
+
+void musiclight_init(void);
+
+// feed a new block of samples into the analysis
+void musiclight_push_block(const struct audio_block *block);
+
+// check whether a new block (STFT hop) is available for the effect
+bool musiclight_hop_ready(void);
+
+/*
+ * Run the next step of the effect if a new block (STFT hop) is available or
+ * the effect is still busy with the previous one. Returns true while the
+ * effect is busy.
+ */
+bool musiclight_process(musiclight_effect effect, uint32_t tick_count);
+
+#endif // MUSICLIGHT_H
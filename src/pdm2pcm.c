@@ -1,119 +1,244 @@
 #include "pdm2pcm.h"
 
-#include "fifo.h"
-
 /*
  * Implementation idea:
- * - low-pass filtering and decimation of incoming bits (samples)
- * - using a moving average
+ * - a fourth order CIC filter (N=4, M=1) decimates the bit stream by half of
+ *   the oversampling ratio
+ * - a halfband FIR filter removes the remaining aliases above the audio band
+ *   and decimates by the last factor of 2
+ *
+ * The CIC integrators would have to run at the bit rate. Instead, they are
+ * advanced by a whole 32 bit word at once: for a cascade of 4 integrators, the
+ * state after 32 steps is a fixed linear combination of the old state plus 4
+ * weighted bit sums of the input. These sums are linear in the input bits, so
+ * they are looked up per byte (one table for each byte position) and added up.
+ */
+
+/*
+ * A bit which has been in the integrator chain for t steps contributes
+ * C(t+k-2, k-1) to integrator k. For bit p of a byte which is followed by o
+ * more bits in the word, t = p + 1 + o.
+ */
+#define BIT(x, p)      (((x) >> (p)) & 1)
+#define T(p, o)        ((p) + 1 + (o))
+#define W1(x, p, o)    (BIT(x, p))
+#define W2(x, p, o)    (BIT(x, p) * T(p, o))
+#define W3(x, p, o)    (BIT(x, p) * T(p, o) * (T(p, o) + 1) / 2)
+#define W4(x, p, o)    (BIT(x, p) * T(p, o) * (T(p, o) + 1) * (T(p, o) + 2) / 6)
+#define SUM8(W, x, o)  (W(x, 0, o) + W(x, 1, o) + W(x, 2, o) + W(x, 3, o) + \
+                        W(x, 4, o) + W(x, 5, o) + W(x, 6, o) + W(x, 7, o))
+
+/* Maximum sums for a whole word: W1 = 32 (6 bits), W2 = 528 (10 bits),
+ * W3 = 5984 (13 bits), W4 = 52360 (16 bits). W1 to W3 are packed into one
+ * value so the four bytes of a word can be added up in parallel. */
+#define E(x, o)        { SUM8(W1, x, o) | SUM8(W2, x, o) << 6 | SUM8(W3, x, o) << 16, \
+                         SUM8(W4, x, o) }
+#define E4(n, o)       E(n, o), E(n+1, o), E(n+2, o), E(n+3, o)
+#define E16(n, o)      E4(n, o), E4(n+4, o), E4(n+8, o), E4(n+12, o)
+#define E64(n, o)      E16(n, o), E16(n+16, o), E16(n+32, o), E16(n+48, o)
+#define E256(o)        { E64(0, o), E64(64, o), E64(128, o), E64(192, o) }
+
+struct cic_lut_entry {
+	uint32_t w123;
+	uint32_t w4;
+};
+
+/* The DMA stores the first 16 bit transfer (MSB first) in the lower half of
+ * the word, so the bytes arrive in the order 1, 0, 3, 2. */
+static const struct cic_lut_entry cic_lut[4][256] = {
+	E256(16), E256(24), E256(0), E256(8)
+};
+
+/*
+ * Halfband filter, Kaiser window (beta = 6), Q15. Every other coefficient is
+ * zero, only the center and the odd taps around it are stored.
+ * Passband: -0.02 dB up to 1/6 of the input rate; stopband: < -52 dB from 1/3.
  */
+#define HB_CENTER 16384
 
+static const int16_t hb_coeffs[] = {10193, -2826, 1151, -434, 122, -14};
 
-// source: Hacker’s Delight, page 66
-// https://books.google.de/books?id=iBNKMspIlqEC&pg=PA66&redir_esc=y#v=onepage&q&f=false
-static inline uint32_t count_bits(uint32_t x)
+#define HB_ODD_TAPS (sizeof(hb_coeffs) / sizeof(hb_coeffs[0]))
+
+#if PDM2PCM_HB_TAPS != 4 * 6 - 1
+#error "PDM2PCM_HB_TAPS does not match the halfband coefficients"
+#endif
+
+int pdm2pcm_init(struct pdm2pcm_ctx *ctx, uint32_t oversampling_ratio)
 {
-	x = x - ((x >> 1) & 0x55555555);
-	x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
-	x = (x + (x >> 4)) & 0x0F0F0F0F;
-	x = x + (x >> 8);
-	x = x + (x >> 16);
-	return x & 0x0000003F;
+	uint32_t log2_ratio = 0;
+
+	if(oversampling_ratio < 64 || oversampling_ratio > 256
+			|| (oversampling_ratio & (oversampling_ratio - 1)) != 0) {
+		return -1;
+	}
+
+	while((1u << log2_ratio) < oversampling_ratio) {
+		log2_ratio++;
+	}
+
+	// the halfband filter does the last decimation by 2
+	ctx->cic_ratio = oversampling_ratio / 2 / 32;
+	ctx->cic_step = ctx->cic_ratio;
+
+	for(int i = 0; i < 4; i++) {
+		ctx->cic_int[i] = 0;
+		ctx->cic_comb[i] = 0;
+	}
+
+	for(int i = 0; i < 2 * PDM2PCM_HB_TAPS; i++) {
+		ctx->hb_hist[i] = 0;
+	}
+
+	ctx->hb_pos = 0;
+	ctx->hb_phase = 0;
+
+	/* CIC gain: (R/2)^4 (full scale of the bipolar values).
+	 * Halfband gain: 2^15. */
+	ctx->out_shift = 4 * (log2_ratio - 1) + 15 - 23;
+
+	return 0;
 }
 
-void pdm2pcm_init(struct pdm2pcm_ctx *ctx, uint32_t oversampling_ratio)
+// Q23 to the FFT sample format
+#ifdef FFT_FIXED_POINT
+static inline fft_sample pcm_to_sample(int32_t pcm)
 {
-	ctx->downsample_ratio = (oversampling_ratio + 4) / 8;
-	ctx->downsample_step = ctx->downsample_ratio;
+	pcm = (pcm + (1 << 7)) >> 8;
 
-	/*
-	for(int i = 0; i <= FILTER_ORDER; i++) {
-		ctx->x[i] = ctx->y[i] = 0;
+	// full scale (1.0) is not representable in Q15
+	if(pcm > INT16_MAX) {
+		return INT16_MAX;
+	} else if(pcm < INT16_MIN) {
+		return INT16_MIN;
 	}
-	*/
-}
 
-uint8_t pdm2pcm_update(struct pdm2pcm_ctx *ctx, uint32_t data_in, int32_t *sample_out)
+	return pcm;
+}
+#else
+static inline fft_sample pcm_to_sample(int32_t pcm)
 {
-	uint8_t sample_generated = 0;
-
-	// downsampling according to this article:
-	// https://curiouser.cheshireeng.com/2015/01/16/pdm-in-a-tiny-cpu/
-	//
-	// Summary:
-	// 1. sum bits in each byte using a lookup-table (CIC with R=8, M=1, N=1)
-	// 2. CIC with R=downsample_ratio, M=2, N=2
-
-	const int8_t bitsum_lut[256] = {
-		#define S(n) (2*(n)-8)
-		#define B2(n) S(n),  S(n+1),  S(n+1),  S(n+2)
-		#define B4(n) B2(n), B2(n+1), B2(n+1), B2(n+2)
-		#define B6(n) B4(n), B4(n+1), B4(n+1), B4(n+2)
-		B6(0), B6(1), B6(1), B6(2)
-	};
+	return pcm * (1.0f / PDM2PCM_FULL_SCALE);
+}
+#endif
 
+/*
+ * The decoder for both output formats. Exactly one of out_pcm and out_samples
+ * is set; as this is inlined into the public functions with constant
+ * arguments, the format check is resolved at compile time.
+ */
+static inline __attribute__((always_inline))
+size_t decode(struct pdm2pcm_ctx *ctx, const uint32_t *data, size_t datalen,
+              int32_t *out_pcm, fft_sample *out_samples)
+{
 	// cache variables for faster access
-	int32_t cic_accu1 = ctx->cic_accu1;
-	int32_t cic_accu2 = ctx->cic_accu2;
+	uint32_t s1 = ctx->cic_int[0];
+	uint32_t s2 = ctx->cic_int[1];
+	uint32_t s3 = ctx->cic_int[2];
+	uint32_t s4 = ctx->cic_int[3];
 
-	int32_t cic_comb1_d1 = ctx->cic_comb1_d1;
-	int32_t cic_comb1_d2 = ctx->cic_comb1_d2;
+	uint32_t d1 = ctx->cic_comb[0];
+	uint32_t d2 = ctx->cic_comb[1];
+	uint32_t d3 = ctx->cic_comb[2];
+	uint32_t d4 = ctx->cic_comb[3];
 
-	int32_t cic_comb2_d1 = ctx->cic_comb2_d1;
-	int32_t cic_comb2_d2 = ctx->cic_comb2_d2;
+	uint32_t cic_step = ctx->cic_step;
+	uint32_t hb_pos = ctx->hb_pos;
+	uint32_t hb_phase = ctx->hb_phase;
 
-	uint32_t downsample_step = ctx->downsample_step;
+	const uint32_t cic_ratio = ctx->cic_ratio;
+	const uint32_t cic_gain = (32 * cic_ratio) * (32 * cic_ratio) * (32 * cic_ratio) * (32 * cic_ratio);
+	const uint32_t out_shift = ctx->out_shift;
 
-	for(uint32_t s = 0; s < 32; s+=8) {
-		// first integrator
-		cic_accu1 += bitsum_lut[(data_in >> s) & 0xFF];
+	int32_t *hb_hist = ctx->hb_hist;
+	size_t nout = 0;
 
-		// second integrator
-		cic_accu2 += cic_accu1;
+	for(size_t w = 0; w < datalen; w++) {
+		uint32_t word = data[w];
 
-		// downsampling
-		if(--(downsample_step) == 0) {
-			downsample_step = ctx->downsample_ratio;
+		const struct cic_lut_entry *e0 = &cic_lut[0][word & 0xFF];
+		const struct cic_lut_entry *e1 = &cic_lut[1][(word >> 8) & 0xFF];
+		const struct cic_lut_entry *e2 = &cic_lut[2][(word >> 16) & 0xFF];
+		const struct cic_lut_entry *e3 = &cic_lut[3][word >> 24];
 
-			// first comb stage
-			int32_t cic_comb1_out = cic_accu2 - cic_comb1_d2;
-			cic_comb1_d2 = cic_comb1_d1;
-			cic_comb1_d1 = cic_accu2;
+		uint32_t w123 = e0->w123 + e1->w123 + e2->w123 + e3->w123;
+		uint32_t w4 = e0->w4 + e1->w4 + e2->w4 + e3->w4;
 
-			// second comb stage: assign output
-			*sample_out = cic_comb1_out - cic_comb2_d2;
-			cic_comb2_d2 = cic_comb2_d1;
-			cic_comb2_d1 = cic_comb1_out;
+		// advance the integrators by 32 steps
+		s4 += 32*s3 + 528*s2 + 5984*s1 + w4;
+		s3 += 32*s2 + 528*s1 + (w123 >> 16);
+		s2 += 32*s1 + ((w123 >> 6) & 0x3FF);
+		s1 += w123 & 0x3F;
 
-			sample_generated = 1;
+		if(--cic_step != 0) {
+			continue;
 		}
-	}
 
-	// write back cached variables
-	ctx->cic_accu1 = cic_accu1;
-	ctx->cic_accu2 = cic_accu2;
+		cic_step = cic_ratio;
 
-	ctx->cic_comb1_d1 = cic_comb1_d1;
-	ctx->cic_comb1_d2 = cic_comb1_d2;
+		// comb stages
+		uint32_t c1 = s4 - d1;
+		uint32_t c2 = c1 - d2;
+		uint32_t c3 = c2 - d3;
+		uint32_t c4 = c3 - d4;
 
-	ctx->cic_comb2_d1 = cic_comb2_d1;
-	ctx->cic_comb2_d2 = cic_comb2_d2;
+		d1 = s4;
+		d2 = c1;
+		d3 = c2;
+		d4 = c3;
 
-	ctx->downsample_step = downsample_step;
+		// halfband filter
+		hb_pos = (hb_pos == PDM2PCM_HB_TAPS - 1) ? 0 : hb_pos + 1;
+		hb_hist[hb_pos] = hb_hist[hb_pos + PDM2PCM_HB_TAPS] = (int32_t)(2*c4 - cic_gain);
 
-	return sample_generated;
-}
+		hb_phase ^= 1;
+		if(hb_phase) {
+			continue;
+		}
 
-void pdm2pcm_decode_to_fifo(struct pdm2pcm_ctx *ctx, uint32_t *data, size_t datalen,
-                            struct fifo_ctx *fifo)
-{
-	int32_t sample;
+		const int32_t *x = &hb_hist[hb_pos + 1]; // oldest value first
+		int64_t acc = (int64_t)HB_CENTER * x[PDM2PCM_HB_TAPS / 2];
 
-	for(size_t w = 0; w < datalen; w++) {
-		uint32_t word = data[w];
+		for(uint32_t i = 0; i < HB_ODD_TAPS; i++) {
+			acc += (int64_t)hb_coeffs[i] *
+				(x[PDM2PCM_HB_TAPS/2 - 1 - 2*i] + x[PDM2PCM_HB_TAPS/2 + 1 + 2*i]);
+		}
 
-		if(pdm2pcm_update(ctx, word, &sample)) {
-			fifo_push(fifo, sample << (24-14));
+		int32_t pcm = (int32_t)((acc + (1 << (out_shift - 1))) >> out_shift);
+
+		if(out_samples) {
+			out_samples[nout++] = pcm_to_sample(pcm);
+		} else {
+			out_pcm[nout++] = pcm;
 		}
 	}
+
+	// write back cached variables
+	ctx->cic_int[0] = s1;
+	ctx->cic_int[1] = s2;
+	ctx->cic_int[2] = s3;
+	ctx->cic_int[3] = s4;
+
+	ctx->cic_comb[0] = d1;
+	ctx->cic_comb[1] = d2;
+	ctx->cic_comb[2] = d3;
+	ctx->cic_comb[3] = d4;
+
+	ctx->cic_step = cic_step;
+	ctx->hb_pos = hb_pos;
+	ctx->hb_phase = hb_phase;
+
+	return nout;
+}
+
+size_t pdm2pcm_decode(struct pdm2pcm_ctx *ctx, const uint32_t *data, size_t datalen,
+                      int32_t *out)
+{
+	return decode(ctx, data, datalen, out, NULL);
+}
+
+size_t pdm2pcm_decode_samples(struct pdm2pcm_ctx *ctx, const uint32_t *data, size_t datalen,
+                              fft_sample *out)
+{
+	return decode(ctx, data, datalen, NULL, out);
 }
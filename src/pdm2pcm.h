@@ -4,28 +4,50 @@
 #include <stdint.h>
 #include <stdlib.h>
 
-#define FILTER_ORDER 4
+#include "config.h"
 
-struct fifo_ctx;
+// output value of a PDM stream of only ones
+#define PDM2PCM_FULL_SCALE (1 << 23)
+
+// length of the halfband filter after the CIC stage
+#define PDM2PCM_HB_TAPS 23
 
 struct pdm2pcm_ctx {
-	uint32_t downsample_ratio;
-	uint32_t downsample_step;
+	uint32_t cic_ratio; // CIC decimation ratio in words
+	uint32_t cic_step;
 
-	int32_t cic_accu1;
-	int32_t cic_accu2;
+	// CIC integrators and comb delays; wrap-around is intended
+	uint32_t cic_int[4];
+	uint32_t cic_comb[4];
 
-	int32_t cic_comb1_d1;
-	int32_t cic_comb1_d2;
+	// halfband history; each value is stored twice for a contiguous window
+	int32_t hb_hist[2 * PDM2PCM_HB_TAPS];
+	uint32_t hb_pos;
+	uint32_t hb_phase;
 
-	int32_t cic_comb2_d1;
-	int32_t cic_comb2_d2;
+	uint32_t out_shift;
 };
 
-void pdm2pcm_init(struct pdm2pcm_ctx *ctx, uint32_t oversampling_ratio);
-uint8_t pdm2pcm_update(struct pdm2pcm_ctx *ctx, uint32_t data_in, int32_t *sample_out);
-
-void pdm2pcm_decode_to_fifo(struct pdm2pcm_ctx *ctx, uint32_t *data, size_t datalen,
-                            struct fifo_ctx *fifo);
+/*
+ * The oversampling ratio (PDM bits per output sample) must be a power of two
+ * from 64 to 256. Returns 0 on success, -1 if the ratio is not supported.
+ */
+int pdm2pcm_init(struct pdm2pcm_ctx *ctx, uint32_t oversampling_ratio);
+
+/*
+ * Decode datalen words of PDM data as written by the I2S DMA (16 bit
+ * transfers packed into 32 bit words, MSB first). out must have room for
+ * datalen * 32 / oversampling_ratio + 1 samples. Returns the number of samples
+ * written.
+ */
+size_t pdm2pcm_decode(struct pdm2pcm_ctx *ctx, const uint32_t *data, size_t datalen,
+                      int32_t *out);
+
+/*
+ * Like pdm2pcm_decode(), but write the samples in the FFT sample format
+ * (full scale: 1.0), e.g. directly into the analysis buffer.
+ */
+size_t pdm2pcm_decode_samples(struct pdm2pcm_ctx *ctx, const uint32_t *data, size_t datalen,
+                              fft_sample *out);
 
 #endif // PDM2PCM_H
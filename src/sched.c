@@ -0,0 +1,194 @@
+#include <stddef.h>
+
+#include "sched.h"
+
+static struct sched_task *sched_tasks = NULL;
+static uint32_t (*sched_clock)(void) = NULL;
+
+// a is before b (with wrap-around)
+static inline bool sched_before(uint32_t a, uint32_t b)
+{
+	return (int32_t)(a - b) < 0;
+}
+
+static inline uint32_t sched_step_index(uint32_t step)
+{
+	return (step < SCHED_MAX_STEPS) ? step : (SCHED_MAX_STEPS - 1);
+}
+
+void sched_init(uint32_t (*clock)(void))
+{
+	sched_tasks = NULL;
+	sched_clock = clock;
+}
+
+void sched_add(struct sched_task *task)
+{
+	struct sched_task **pos = &sched_tasks;
+
+	task->next = NULL;
+	task->active = false;
+	task->next_release = sched_clock() + task->period;
+	task->abs_deadline = 0;
+	task->cur_step = 0;
+
+	for(uint32_t i = 0; i < SCHED_MAX_STEPS; i++) {
+		task->step_time[i] = 0;
+	}
+	task->job_steps = 0;
+
+	task->jobs = 0;
+	task->misses = 0;
+	task->overruns = 0;
+	task->deferrals = 0;
+	task->blocking = 0;
+
+	// keep the order of registration
+	while(*pos) {
+		pos = &(*pos)->next;
+	}
+	*pos = task;
+}
+
+uint32_t sched_get_job_time(const struct sched_task *task)
+{
+	uint32_t sum = 0;
+
+	for(uint32_t i = 0; i < task->job_steps; i++) {
+		sum += task->step_time[sched_step_index(i)];
+	}
+
+	return sum;
+}
+
+static void sched_release(struct sched_task *task, uint32_t release)
+{
+	task->active = true;
+	task->abs_deadline = release + task->deadline;
+	task->cur_step = 0;
+}
+
+static void sched_release_all(uint32_t now)
+{
+	for(struct sched_task *t = sched_tasks; t; t = t->next) {
+		if(t->ready) {
+			if(!t->active && t->ready()) {
+				sched_release(t, now);
+				t->next_release = now + t->period;
+			}
+		} else {
+			while(!sched_before(now, t->next_release)) {
+				if(t->active) {
+					// the running job keeps its deadline, this release is lost
+					t->overruns++;
+				} else {
+					sched_release(t, t->next_release);
+				}
+
+				t->next_release += t->period;
+			}
+		}
+	}
+}
+
+/*
+ * Check whether a step of the given time, started now, still allows every
+ * inactive task with a higher priority to meet the deadline of its next job.
+ */
+static bool sched_step_fits(struct sched_task *task, uint32_t now, uint32_t time)
+{
+	bool fits = true;
+	bool blocking = false;
+
+	for(struct sched_task *h = sched_tasks; h; h = h->next) {
+		if(h == task || h->active || h->priority <= task->priority) {
+			continue;
+		}
+
+		uint32_t release = h->next_release;
+		uint32_t job_time = sched_get_job_time(h);
+
+		// an event which is already overdue may come at any moment
+		if(h->ready && sched_before(release, now)) {
+			release = now;
+		}
+
+		if(!sched_before(release + h->deadline - job_time, now + time)) {
+			continue;
+		}
+
+		// the longest gap between two jobs of the higher priority task; if the
+		// step does not even fit in there, waiting does not help
+		int32_t gap = (int32_t)(h->period + h->deadline - 2 * job_time);
+
+		if(gap < (int32_t)time) {
+			blocking = true;
+		} else {
+			fits = false;
+		}
+	}
+
+	if(fits && blocking) {
+		task->blocking++;
+	}
+
+	return fits;
+}
+
+bool sched_run(void)
+{
+	uint32_t now = sched_clock();
+	struct sched_task *next = NULL;
+
+	sched_release_all(now);
+
+	// earliest deadline first, then the highest priority
+	for(struct sched_task *t = sched_tasks; t; t = t->next) {
+		if(!t->active) {
+			continue;
+		}
+
+		if(!next || sched_before(t->abs_deadline, next->abs_deadline) ||
+				(t->abs_deadline == next->abs_deadline && t->priority > next->priority)) {
+			next = t;
+		}
+	}
+
+	if(!next) {
+		return false;
+	}
+
+	uint32_t idx = sched_step_index(next->cur_step);
+
+	if(!sched_step_fits(next, now, next->step_time[idx])) {
+		next->deferrals++;
+		return false;
+	}
+
+	uint32_t start = sched_clock();
+	bool more = next->step();
+	uint32_t end = sched_clock();
+
+	// keep the longest time, slowly forgetting old values
+	uint32_t time = next->step_time[idx];
+	time -= time >> SCHED_TIME_DECAY_SHIFT;
+	if(end - start > time) {
+		time = end - start;
+	}
+	next->step_time[idx] = time;
+
+	if(more) {
+		next->cur_step++;
+	} else {
+		next->active = false;
+		next->job_steps = next->cur_step + 1;
+		next->cur_step = 0;
+		next->jobs++;
+
+		if(sched_before(next->abs_deadline, end)) {
+			next->misses++;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,98 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Cooperative run-to-completion scheduler for the main loop.
+ *
+ * A task does its work in jobs of one or more steps. Each step runs to
+ * completion and should be short. A job is released periodically (periodic
+ * tasks) or when the ready() function of the task returns true (event-driven
+ * tasks, e.g. when a new audio block is available).
+ *
+ * sched_run() runs one step of the released task with the earliest absolute
+ * deadline. If several tasks have the same deadline, the higher priority wins.
+ * Between two steps of a long job, tasks with a higher priority can run.
+ *
+ * The time of every step is measured with the clock passed to sched_init(),
+ * and the longest recent time is kept per step index. A step is deferred if
+ * it would make a task with a higher priority miss its next deadline. If a
+ * step can never fit in between, it is run anyway and counted as blocking, as
+ * a hint that it should be split.
+ *
+ * All times are in the unit of the clock (microseconds in the firmware) and
+ * may wrap around.
+ */
+
+// steps per job with their own execution time (further steps share the last)
+#define SCHED_MAX_STEPS 16
+
+// the measured step times decay by 2^-SCHED_TIME_DECAY_SHIFT per run, so a
+// single outlier (e.g. delayed by interrupts) is forgotten eventually
+#define SCHED_TIME_DECAY_SHIFT 6
+
+struct sched_task {
+	const char *name;
+
+	// run the next step of the current job; returns true if the job has more
+	// steps
+	bool (*step)(void);
+
+	// event-driven tasks only (NULL for periodic tasks): returns true if a new
+	// job is available; only polled while no job of the task is active
+	bool (*ready)(void);
+
+	// time between two releases; for event-driven tasks the minimum expected
+	// time, which is used to estimate the next release
+	uint32_t period;
+
+	// time from the release until the job must be complete
+	uint32_t deadline;
+
+	// higher is more important
+	uint8_t priority;
+
+	// managed by the scheduler
+	struct sched_task *next;
+
+	bool active;            // a job is released and not complete yet
+	uint32_t next_release;  // (earliest) time of the next release
+	uint32_t abs_deadline;  // deadline of the active job
+	uint32_t cur_step;      // index of the next step of the active job
+
+	uint32_t step_time[SCHED_MAX_STEPS]; // longest recent time per step
+	uint32_t job_steps;     // steps of the last complete job
+
+	// statistics
+	uint32_t jobs;          // complete jobs
+	uint32_t misses;        // jobs completed after their deadline
+	uint32_t overruns;      // periodic releases lost as the job was still active
+	uint32_t deferrals;     // steps deferred for a task with a higher priority
+	uint32_t blocking;      // steps run although they delay such a task
+};
+
+/*
+ * Reset the scheduler and set the clock used for releases and measurements.
+ */
+void sched_init(uint32_t (*clock)(void));
+
+/*
+ * Add a task. The public fields must be set; periodic tasks are first released
+ * one period from now.
+ */
+void sched_add(struct sched_task *task);
+
+/*
+ * Release new jobs and run at most one step. Returns true if a step was run,
+ * false if there was nothing to do or the next step was deferred.
+ */
+bool sched_run(void);
+
+/*
+ * Worst case time of a complete job of the task, from the measured steps.
+ */
+uint32_t sched_get_job_time(const struct sched_task *task);
+
+#endif // SCHED_H
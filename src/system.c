@@ -6,6 +6,7 @@
 
 /* Symbols exported by the linker script(s): */
 extern unsigned _data_loadaddr, _data, _edata, _ebss, _stack;
+extern unsigned _ccmram, _eccmram;
 typedef void (*funcp_t) (void);
 extern funcp_t __preinit_array_start, __preinit_array_end;
 extern funcp_t __init_array_start, __init_array_end;
@@ -48,6 +49,10 @@ void __attribute__ ((naked)) reset_handler(void)
 		*dest++ = 0;
 	}
 
+	for (dest = &_ccmram; dest < &_eccmram; dest++) {
+		*dest = 0;
+	}
+
 	/* Constructors. */
 	for (fp = &__preinit_array_start; fp < &__preinit_array_end; fp++) {
 		(*fp)();
@@ -3,40 +3,46 @@
 
 #include "tictoc.h"
 
+static uint32_t tictoc_start_value;
 static uint32_t tictoc_last_value;
 
 void tictoc_init(void)
 {
-  // enable TIM4 clock
-	rcc_peripheral_enable_clock(&RCC_APB1ENR, RCC_APB1ENR_TIM6EN);
+  // enable TIM2 clock (TIM2 is one of the 32 bit timers)
+	rcc_peripheral_enable_clock(&RCC_APB1ENR, RCC_APB1ENR_TIM2EN);
 
   // - upcounter
   // - clock: CK_INT
-  TIM6_CR1 = 0x0000;
+  TIM2_CR1 = 0x0000;
 
   // defaults for TIM_CR2
 
   // prescaler
-  TIM6_PSC = 59; // 60 MHz APB1 clock -> 1 MHz counter frequency
+  TIM2_PSC = 59; // 60 MHz APB1 clock -> 1 MHz counter frequency
 
   // auto-reload (maximum value)
-  TIM6_ARR = 0xFFFFFFFF; // overflow every 1 ms
+  TIM2_ARR = 0xFFFFFFFF; // overflow every 71.6 minutes
 
   // generate an update event
-  TIM6_EGR |= TIM_EGR_UG;
+  TIM2_EGR |= TIM_EGR_UG;
 
   // start the timer
-  TIM6_CR1 |= TIM_CR1_CEN;
+  TIM2_CR1 |= TIM_CR1_CEN;
+}
+
+uint32_t tictoc_now(void)
+{
+  return timer_get_counter(TIM2);
 }
 
 void tic(void)
 {
-  timer_set_counter(TIM6, 0);
+  tictoc_start_value = tictoc_now();
 }
 
 void toc(void)
 {
-  tictoc_last_value = timer_get_counter(TIM6);
+  tictoc_last_value = tictoc_now() - tictoc_start_value;
 }
 
 uint32_t tictoc_get_last_duration(void)
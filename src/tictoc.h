@@ -8,6 +8,14 @@
  */
 void tictoc_init(void);
 
+/*!
+ * Get the current time of the free-running timer, e.g. as clock for the
+ * scheduler (see sched.h).
+ *
+ * \returns The time in timer ticks (microseconds), wrapping around.
+ */
+uint32_t tictoc_now(void);
+
 /*!
  * Start a measurement.
  */
@@ -23,7 +31,7 @@ void toc(void);
 /*!
  * Get the last duration value measured.
  *
- * \returns The duration in timer ticks.
+ * \returns The duration in timer ticks (microseconds).
  */
 uint32_t tictoc_get_last_duration(void);
 
@@ -2,6 +2,8 @@
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/dma.h>
 #include <libopencm3/stm32/spi.h>
+#include <libopencm3/stm32/timer.h>
+#include <libopencm3/cm3/nvic.h>
 
 #include "ws2801.h"
 
@@ -12,35 +14,93 @@
  * conversion. This inverts the signal, so we have to correct this in software.
  */
 
-void send_message(void);
-void dma_stream5_isr(void);
+/*
+ * The transfers are started from interrupt context only: by the DMA interrupt
+ * (triggered by software from ws2801_send_update() if the strip is idle) or
+ * after the drain and latch time by the TIM7 interrupt. Both have the same priority, so
+ * they never interrupt each other.
+ */
+enum ws2801_state {
+  WS2801_IDLE,
+  WS2801_BUSY,  // DMA transfer running
+  WS2801_DRAIN, // DMA done, SPI still shifting out the last bytes
+  WS2801_LATCH, // waiting for the modules to take over the data
+};
+
+/*
+ * The DMA is done when the last byte is written to the SPI, which then still
+ * shifts out at most two bytes: 16 bits at 30 MHz / 64 take 34 us. Instead of
+ * polling SPI_SR_BSY in the interrupt, TIM7 first waits for this worst case.
+ */
+#define WS2801_DRAIN_US 40
+
+static volatile enum ws2801_state state = WS2801_IDLE;
+static uint32_t queued = 0;
 
-static uint8_t message[3*WS2801_NUM_MODULES];
+void dma_stream5_isr(void);
+void tim7_isr(void);
 
-void send_message(void)
+// start sending the queued message, if any
+static void start_next_message(void)
 {
-  // wait for previous DMA request to complete
-  while(DMA1_S5CR & DMA_SxCR_EN);
+  const uint8_t *message = ws2801_take_message();
+
+  if(!message) {
+    state = WS2801_IDLE;
+    return;
+  }
 
   // switch MOSI to SPI mode
   gpio_mode_setup(GPIOB, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO3 | GPIO5);
 
   // initiate DMA transfer
-  DMA1_S5M0AR = message;
+  DMA1_S5M0AR = (uint8_t *)message;
   DMA1_S5NDTR = 3*WS2801_NUM_MODULES;
   DMA1_HIFCR |= DMA_HIFCR_CTCIF5 | DMA_HIFCR_CDMEIF5 | DMA_HIFCR_CFEIF5 | DMA_HIFCR_CTEIF5;
   DMA1_S5CR |= DMA_SxCR_EN;
+
+  state = WS2801_BUSY;
+}
+
+// restart TIM7 in one pulse mode with the given period
+static void start_timer(uint32_t period_us)
+{
+  timer_set_period(TIM7, period_us);
+  timer_set_counter(TIM7, 0);
+  timer_enable_counter(TIM7);
 }
 
 void dma_stream5_isr(void)
 {
   if(DMA1_HISR & DMA_HISR_TCIF5) {
-    // force MOSI low after transmission is complete (for data commit)
-    gpio_mode_setup(GPIOB, GPIO_MODE_OUTPUT, GPIO_PUPD_NONE, GPIO3 | GPIO5);
-    gpio_clear(GPIOB, GPIO3 | GPIO5);
-
     // clear interrupt flag
     DMA1_HIFCR |= DMA_HIFCR_CTCIF5;
+
+    // let the SPI shift out the last bytes (see tim7_isr())
+    state = WS2801_DRAIN;
+    start_timer(WS2801_DRAIN_US);
+  } else if(state == WS2801_IDLE) {
+    // triggered by ws2801_send_update()
+    start_next_message();
+  }
+}
+
+void tim7_isr(void)
+{
+  if(timer_get_flag(TIM7, TIM_SR_UIF)) {
+    timer_clear_flag(TIM7, TIM_SR_UIF);
+
+    if(state == WS2801_DRAIN) {
+      // force MOSI low after transmission is complete (for data commit)
+      gpio_mode_setup(GPIOB, GPIO_MODE_OUTPUT, GPIO_PUPD_NONE, GPIO3 | GPIO5);
+      gpio_clear(GPIOB, GPIO3 | GPIO5);
+
+      // the next frame must wait for the latch time
+      state = WS2801_LATCH;
+      start_timer(WS2801_LATCH_US);
+    } else {
+      start_next_message();
+    }
   }
 }
 
@@ -62,6 +122,21 @@ void ws2801_setup_dma(void)
   DMA1_S5FCR = DMA_SxFCR_DMDIS | DMA_SxFCR_FTH_2_4_FULL;
 
   spi_enable_tx_dma(SPI3);
+
+  // TIM7 measures the drain and latch time after each frame (one pulse mode,
+  // the period is set before each start)
+	rcc_peripheral_enable_clock(&RCC_APB1ENR, RCC_APB1ENR_TIM7EN);
+
+  timer_reset(TIM7);
+  timer_one_shot_mode(TIM7);
+  timer_update_on_overflow(TIM7);
+  timer_set_prescaler(TIM7, 59); // 60 MHz APB1 timer clock -> 1 MHz
+  timer_set_period(TIM7, WS2801_LATCH_US);
+  timer_generate_event(TIM7, TIM_EGR_UG); // load the prescaler
+  timer_enable_irq(TIM7, TIM_DIER_UIE);
+
+  nvic_enable_irq(NVIC_TIM7_IRQ);
+  nvic_enable_irq(NVIC_DMA1_STREAM5_IRQ);
 }
 
 void ws2801_init(void)
@@ -94,26 +169,25 @@ void ws2801_init(void)
   spi_enable(SPI3);
 }
 
-void ws2801_set_colour(uint8_t module, float red, float green, float blue)
+enum ws2801_send_status ws2801_send_update(void)
 {
-  // perform gamma correction and convert to integer
-  uint8_t red_int   = 255.0f * red*red;
-  uint8_t green_int = 255.0f * green*green;
-  uint8_t blue_int  = 255.0f * blue*blue;
-
-  // Invert signal, as we have inverting level shifters
-	//message[3*module + 0] = ~red_int;
-	//message[3*module + 1] = ~green_int;
-	//message[3*module + 2] = ~blue_int;
-
-	// non-inverted, but RBG value order
-	message[3*module + 0] = red_int;
-	message[3*module + 2] = green_int;
-	message[3*module + 1] = blue_int;
+  enum ws2801_send_status status = (state == WS2801_IDLE) ? WS2801_SENT : WS2801_QUEUED;
+
+  ws2801_queue_message();
+
+  if(status == WS2801_QUEUED) {
+    queued++;
+  }
+
+  // start the transfer from the DMA interrupt if the strip is idle (otherwise
+  // this does nothing and the frame is started after the running one)
+  nvic_generate_software_interrupt(NVIC_DMA1_STREAM5_IRQ);
+
+  return status;
 }
 
-void ws2801_send_update(void)
+uint32_t ws2801_get_queued(void)
 {
-	send_message();
+  return queued;
 }
 
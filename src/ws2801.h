@@ -2,12 +2,72 @@
 #define WS2801_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #define WS2801_NUM_MODULES 32
 
+// time the clock must stay low after a frame until the modules take over the
+// data, in microseconds
+#define WS2801_LATCH_US 500
+
 void ws2801_init(void);
 void ws2801_setup_dma(void);
+
+/*
+ * Double-buffered frame update without waiting for the SPI:
+ *
+ *   if(ws2801_begin_update()) {
+ *     ... ws2801_set_colour() for the modules ...
+ *     ws2801_send_update();
+ *   }
+ *
+ * ws2801_send_update() queues the frame, which is sent as soon as the running
+ * transfer and the latch time are over. Until then, no new frame can be
+ * written: ws2801_begin_update() returns false and counts the frame as
+ * dropped. Modules which are not set keep the colour of the previous frame.
+ */
+bool ws2801_begin_update(void);
 void ws2801_set_colour(uint8_t module, float red, float green, float blue);
-void ws2801_send_update(void);
+
+/*
+ * Set all modules at once from arrays of WS2801_NUM_MODULES linear brightness
+ * values: 16 bit (full scale 0xFFFF), Q15 or float (0..1, clamped). The gamma
+ * correction is a lookup in led_gamma_lut (generated by gen_lut.py) instead of
+ * float arithmetic per channel.
+ *
+ * The 8 bit output is temporally dithered (unless disabled): the fraction of
+ * the gamma corrected value is spread over successive frames, so the dark
+ * levels, which are only a few PWM steps apart, do not band. Single modules
+ * set by ws2801_set_colour() are not dithered.
+ */
+void ws2801_set_frame(const uint16_t *red, const uint16_t *green, const uint16_t *blue);
+void ws2801_set_frame_q15(const int16_t *red, const int16_t *green, const int16_t *blue);
+void ws2801_set_frame_float(const float *red, const float *green, const float *blue);
+
+void ws2801_set_dithering(bool enable);
+
+enum ws2801_send_status {
+	WS2801_SENT,   // the transfer has been started
+	WS2801_QUEUED, // the transfer starts after the running one
+};
+
+enum ws2801_send_status ws2801_send_update(void);
+
+// frames rejected by ws2801_begin_update() and frames which had to wait for a
+// running transfer
+uint32_t ws2801_get_dropped(void);
+uint32_t ws2801_get_queued(void);
+
+// the message being written (back buffer) in wire format (3 bytes per module
+// in RBG order), as set by ws2801_set_colour() or the frame functions
+const uint8_t* ws2801_get_message(void);
+
+/*
+ * For the transfer (see ws2801.c): hand the back buffer over to be sent, and
+ * take the queued message (NULL if none) while swapping the buffers. The
+ * returned message stays valid until the next ws2801_take_message().
+ */
+void ws2801_queue_message(void);
+const uint8_t* ws2801_take_message(void);
 
 #endif // WS2801_H
@@ -0,0 +1,182 @@
+#include <stddef.h>
+
+#include "ws2801.h"
+
+#include "lut.h"
+
+/*
+ * The messages in wire format, independent of the SPI/DMA hardware (see
+ * ws2801.c), so the colour conversion can also run on the host.
+ *
+ * There are two buffers: the application writes the back buffer while the
+ * DMA may read the front buffer. A back buffer which has been queued by
+ * ws2801_queue_message() belongs to the sender until ws2801_take_message()
+ * swaps the buffers.
+ */
+
+static uint8_t messages[2][3*WS2801_NUM_MODULES];
+
+static uint32_t back = 0; // index of the back buffer
+static uint32_t queued = 0; // the back buffer is waiting to be sent
+static uint32_t dropped = 0;
+
+static bool dithering = true;
+static uint32_t dither_frame = 0;
+
+/*
+ * Thresholds of the temporal dithering, in units of the 8 fractional bits of
+ * led_gamma_lut: a fraction f is rounded up in about f/16 of 16 consecutive
+ * frames. The order is bit-reversed, so these frames are spread evenly, and
+ * neighbouring modules are at different phases of the cycle.
+ */
+#define WS2801_DITHER_LEN 16
+
+static const uint8_t dither_thresholds[WS2801_DITHER_LEN] = {
+	8, 136, 72, 200, 40, 168, 104, 232, 24, 152, 88, 216, 56, 184, 120, 248
+};
+
+bool ws2801_begin_update(void)
+{
+	if(__atomic_load_n(&queued, __ATOMIC_ACQUIRE)) {
+		dropped++;
+		return false;
+	}
+
+	return true;
+}
+
+static inline uint16_t ws2801_linear_float(float v)
+{
+	if(v <= 0) {
+		return 0;
+	} else if(v >= 1.0f) {
+		return 0xFFFF;
+	}
+
+	return v * 0xFFFF + 0.5f;
+}
+
+static inline uint16_t ws2801_linear_q15(int16_t v)
+{
+	if(v <= 0) {
+		return 0;
+	}
+
+	// 0x7FFF -> 0xFFFF
+	return ((uint16_t)v << 1) | ((uint16_t)v >> 14);
+}
+
+// gamma correction of a 16 bit linear value, rounded with the given threshold
+static inline uint8_t ws2801_gamma(uint16_t v, uint32_t threshold)
+{
+	return (led_gamma_lut[v >> (16 - LED_GAMMA_BITS)] + threshold) >> 8;
+}
+
+static inline uint32_t ws2801_dither_threshold(uint32_t phase, uint32_t module)
+{
+	if(!dithering) {
+		return 0;
+	}
+
+	return dither_thresholds[(phase + module) % WS2801_DITHER_LEN];
+}
+
+static inline void ws2801_put(uint8_t *out, uint16_t red, uint16_t green, uint16_t blue,
+		uint32_t threshold)
+{
+	// Invert signal, as we have inverting level shifters
+	//out[0] = ~ws2801_gamma(red, threshold);
+	//out[1] = ~ws2801_gamma(blue, threshold);
+	//out[2] = ~ws2801_gamma(green, threshold);
+
+	// non-inverted, but RBG value order
+	out[0] = ws2801_gamma(red, threshold);
+	out[1] = ws2801_gamma(blue, threshold);
+	out[2] = ws2801_gamma(green, threshold);
+}
+
+void ws2801_set_colour(uint8_t module, float red, float green, float blue)
+{
+	ws2801_put(messages[back] + 3*module,
+			ws2801_linear_float(red), ws2801_linear_float(green), ws2801_linear_float(blue), 0);
+}
+
+/*
+ * The frame functions write the whole message in one pass. The dithering
+ * phase advances with every frame.
+ */
+void ws2801_set_frame(const uint16_t *red, const uint16_t *green, const uint16_t *blue)
+{
+	uint8_t *out = messages[back];
+	uint32_t phase = dither_frame++;
+
+	for(uint32_t i = 0; i < WS2801_NUM_MODULES; i++, out += 3) {
+		ws2801_put(out, red[i], green[i], blue[i], ws2801_dither_threshold(phase, i));
+	}
+}
+
+void ws2801_set_frame_q15(const int16_t *red, const int16_t *green, const int16_t *blue)
+{
+	uint8_t *out = messages[back];
+	uint32_t phase = dither_frame++;
+
+	for(uint32_t i = 0; i < WS2801_NUM_MODULES; i++, out += 3) {
+		ws2801_put(out, ws2801_linear_q15(red[i]), ws2801_linear_q15(green[i]),
+				ws2801_linear_q15(blue[i]), ws2801_dither_threshold(phase, i));
+	}
+}
+
+void ws2801_set_frame_float(const float *red, const float *green, const float *blue)
+{
+	uint8_t *out = messages[back];
+	uint32_t phase = dither_frame++;
+
+	for(uint32_t i = 0; i < WS2801_NUM_MODULES; i++, out += 3) {
+		ws2801_put(out, ws2801_linear_float(red[i]), ws2801_linear_float(green[i]),
+				ws2801_linear_float(blue[i]), ws2801_dither_threshold(phase, i));
+	}
+}
+
+void ws2801_set_dithering(bool enable)
+{
+	dithering = enable;
+}
+
+const uint8_t* ws2801_get_message(void)
+{
+	return messages[back];
+}
+
+void ws2801_queue_message(void)
+{
+	// the message must be complete before it is handed over
+	__atomic_store_n(&queued, 1, __ATOMIC_RELEASE);
+}
+
+const uint8_t* ws2801_take_message(void)
+{
+	const uint8_t *front;
+	uint8_t *next_back;
+
+	if(!__atomic_load_n(&queued, __ATOMIC_ACQUIRE)) {
+		return NULL;
+	}
+
+	front = messages[back];
+	back ^= 1;
+	next_back = messages[back];
+
+	// modules which are not set for the next frame keep their colour
+	for(uint32_t i = 0; i < 3*WS2801_NUM_MODULES; i++) {
+		next_back[i] = front[i];
+	}
+
+	__atomic_store_n(&queued, 0, __ATOMIC_RELEASE);
+
+	return front;
+}
+
+uint32_t ws2801_get_dropped(void)
+{
+	return dropped;
+}